@@ -342,7 +342,8 @@ namespace gbe
   ///////////////////////////////////////////////////////////////////////////
 
   Context::Context(const ir::Unit &unit, const std::string &name) :
-    unit(unit), fn(*unit.getFunction(name)), name(name), liveness(NULL), dag(NULL), useDWLabel(false)
+    unit(unit), fn(*unit.getFunction(name)), name(name), liveness(NULL), dag(NULL), useDWLabel(false),
+    localIDInPrologue(false)
   {
     GBE_ASSERT(unit.getPointerSize() == ir::POINTER_32_BITS || unit.getPointerSize() == ir::POINTER_64_BITS);
     this->liveness = GBE_NEW(ir::Liveness, const_cast<ir::Function&>(fn), true);
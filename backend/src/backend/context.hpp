@@ -107,7 +107,7 @@ namespace gbe
     }
     /*! get register's payload type. */
     INLINE void getRegPayloadType(ir::Register reg, gbe_curbe_type &curbeType, int &subType) const {
-      if (reg.value() >= fn.getRegisterFile().regNum()) {
+      if (reg.value() >= fn.getRegisterFile().regNum() || isPrologueLocalID(reg)) {
         curbeType = GBE_GEN_REG;
         subType = 0;
         return;
@@ -116,10 +116,17 @@ namespace gbe
     }
     /*! check whether a register is a payload register */
     INLINE bool isPayloadReg(ir::Register reg) const{
-      if (reg.value() >= fn.getRegisterFile().regNum())
+      if (reg.value() >= fn.getRegisterFile().regNum() || isPrologueLocalID(reg))
         return false;
       return fn.isPayloadReg(reg);
     }
+    /*! Tells if the local IDs are computed by the kernel prologue */
+    INLINE bool hasLocalIDInPrologue(void) const { return localIDInPrologue; }
+    /*! Local IDs are regular registers when the prologue computes them */
+    INLINE bool isPrologueLocalID(ir::Register reg) const {
+      return localIDInPrologue &&
+             (reg == ir::ocl::lid0 || reg == ir::ocl::lid1 || reg == ir::ocl::lid2);
+    }
   protected:
     /*! Build the instruction stream. Return false if failed */
     virtual bool emitCode(void) = 0;
@@ -161,6 +168,7 @@ namespace gbe
     JIPMap JIPs;                          //!< Where to jump all labels/branches
     uint32_t simdWidth;                   //!< Number of lanes per HW threads
     bool useDWLabel;                      //!< false means using u16 label, true means using u32 label.
+    bool localIDInPrologue;               //!< local IDs are not pushed in the curbe
     map<unsigned char, ir::Register> btiRegMap;
     GBE_CLASS(Context);                   //!< Use custom allocators
   };
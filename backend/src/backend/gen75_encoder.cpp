@@ -240,6 +240,7 @@ namespace gbe
                insn.header.opcode == GEN_OPCODE_IF ||
                insn.header.opcode == GEN_OPCODE_BRC ||
                insn.header.opcode == GEN_OPCODE_WHILE ||
+               insn.header.opcode == GEN_OPCODE_BREAK ||
                insn.header.opcode == GEN_OPCODE_ELSE);
 
     if( insn.header.opcode == GEN_OPCODE_WHILE ){
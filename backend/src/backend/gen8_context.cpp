@@ -47,6 +47,11 @@ namespace gbe
     return i;
   }
 
+  BVAR(OCL_LOCAL_ID_IN_PROLOGUE, true);
+  bool Gen8Context::supportLocalIDInPrologue(void) const {
+    return OCL_LOCAL_ID_IN_PROLOGUE;
+  }
+
   void Gen8Context::newSelection(void) {
     this->sel = GBE_NEW(Selection8, *this);
   }
@@ -725,22 +730,24 @@ namespace gbe
     dst.type = GEN_TYPE_UL;
     res.type = GEN_TYPE_UL;
 
-    /* Low 32 bits X low 32 bits. */
     GenRegister s0l = unpacked_ud(src0);
     GenRegister s1l = unpacked_ud(src1);
+    GenRegister s0h = unpacked_ud(src0, 1);
+    GenRegister s1h = unpacked_ud(src1, 1);
+
+    /* The cross products only reach the high 32 bits of the result, so the
+       native 32x32 MUL keeping the low dword of each is enough for them.
+       Sum them in the two halves of the temporary, all in dword ALU ops. */
+    GenRegister resl = unpacked_ud(res);
+    GenRegister resh = unpacked_ud(res, 1);
+    p->MUL(resl, s0l, s1h);
+    p->MUL(resh, s0h, s1l);
+    p->ADD(resl, resl, resh);
+
+    /* Low 32 bits X low 32 bits, the only full qword product. */
     p->MUL(dst, s0l, s1l);
-
-    /* Low 32 bits X high 32 bits. */
-    GenRegister s1h = GenRegister::offset(s1l, 0, 4);
-    p->MUL(res, s0l, s1h);
-    p->SHL(res, res, GenRegister::immud(32));
-    p->ADD(dst, dst, res);
-
-    /* High 32 bits X low 32 bits. */
-    GenRegister s0h = GenRegister::offset(s0l, 0, 4);
-    p->MUL(res, s0h, s1l);
-    p->SHL(res, res, GenRegister::immud(32));
-    p->ADD(dst, dst, res);
+    GenRegister dsth = unpacked_ud(dst, 1);
+    p->ADD(dsth, dsth, resl);
   }
 
   void Gen8Context::emitI64HADDInstruction(const SelectionInstruction &insn)
@@ -47,6 +47,8 @@ namespace gbe
     }
     /*! Get the pointer argument size for curbe alloc */
     virtual uint32_t getPointerSize(void) { return 8; }
+    /*! Gen8+ reads the cross thread curbe once for all the threads */
+    virtual bool supportLocalIDInPrologue(void) const;
     /*! Set the correct target values for the branches */
     virtual bool patchBranches(void);
 
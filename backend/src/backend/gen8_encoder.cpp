@@ -402,6 +402,7 @@ namespace gbe
                insn.header.opcode == GEN_OPCODE_IF ||
                insn.header.opcode == GEN_OPCODE_BRC ||
                insn.header.opcode == GEN_OPCODE_WHILE ||
+               insn.header.opcode == GEN_OPCODE_BREAK ||
                insn.header.opcode == GEN_OPCODE_ELSE);
 
     if( insn.header.opcode == GEN_OPCODE_WHILE ) {
@@ -417,7 +418,8 @@ namespace gbe
       uip = jip;
 
     if (insn.header.opcode == GEN_OPCODE_IF ||
-        insn.header.opcode == GEN_OPCODE_ELSE) {
+        insn.header.opcode == GEN_OPCODE_ELSE ||
+        insn.header.opcode == GEN_OPCODE_BREAK) {
       Gen8NativeInstruction *gen8_insn = &insn.gen8_insn;
       this->setSrc0(&insn, GenRegister::immud(0));
       gen8_insn->bits2.gen8_branch.uip = uip*8;
@@ -67,6 +67,8 @@ namespace gbe
     this->limitRegisterPressure = limitRegisterPressure;
     this->reservedSpillRegs = reservedSpillRegs;
     Context::startNewCG(simdWidth);
+    // The profiling prolog reads the local IDs before anything else runs
+    this->localIDInPrologue = !this->inProfilingMode && this->supportLocalIDInPrologue();
     GBE_SAFE_DELETE(ra);
     GBE_SAFE_DELETE(sel);
     GBE_SAFE_DELETE(p);
@@ -210,6 +212,55 @@ namespace gbe
     p->pop();
   }
 
+  void GenContext::emitLocalID(void) {
+    using namespace ir;
+    if (!this->localIDInPrologue)
+      return;
+    const Register lidReg[3] = {ocl::lid0, ocl::lid1, ocl::lid2};
+    bool used[3];
+    GenRegister lid[3];
+    for (uint32_t i = 0; i < 3; ++i) {
+      used[i] = ra->isAllocated(lidReg[i]);
+      if (used[i])
+        lid[i] = ra->genReg(this->simdWidth == 8 ?
+                            GenRegister::ud8grf(lidReg[i]) :
+                            GenRegister::ud16grf(lidReg[i]));
+    }
+    if (!used[0] && !used[1] && !used[2])
+      return;
+
+    GBE_ASSERT(ra->isAllocated(ocl::threadid));
+    const GenRegister threadID = ra->genReg(GenRegister::ud1grf(ocl::threadid));
+    const GenRegister lsize0 = ra->genReg(GenRegister::ud1grf(ocl::lsize0));
+    // borrow block ip as temporary register as we will
+    // initialize block ip latter.
+    const GenRegister laneID = GenRegister::retype(getBlockIP(), GEN_TYPE_UW);
+    // The flat ID in the work group goes to the first allocated local ID and
+    // the quotient by the local size 0 to the next one
+    const uint32_t flat = used[0] ? 0 : (used[1] ? 1 : 2);
+    const uint32_t quot = used[1] ? 1 : 2;
+
+    p->push();
+      p->curr.predicate = GEN_PREDICATE_NONE;
+      p->curr.noMask = 1;
+      p->curr.execWidth = this->simdWidth;
+      loadLaneID(laneID);
+      // threadId * simdWidth + laneId
+      p->SHL(lid[flat], threadID, GenRegister::immud(this->simdWidth == 8 ? 3 : 4));
+      p->ADD(lid[flat], lid[flat], laneID);
+      if (used[1] || used[2]) {
+        p->MATH(lid[quot], GEN_MATH_FUNCTION_INT_DIV_QUOTIENT, lid[flat], lsize0);
+        const GenRegister lsize1 = ra->genReg(GenRegister::ud1grf(ocl::lsize1));
+        if (used[2])
+          p->MATH(lid[2], GEN_MATH_FUNCTION_INT_DIV_QUOTIENT, lid[quot], lsize1);
+        if (used[1])
+          p->MATH(lid[1], GEN_MATH_FUNCTION_INT_DIV_REMAINDER, lid[1], lsize1);
+      }
+      if (used[0])
+        p->MATH(lid[0], GEN_MATH_FUNCTION_INT_DIV_REMAINDER, lid[0], lsize0);
+    p->pop();
+  }
+
   void GenContext::emitStackPointer(void) {
     using namespace ir;
 
@@ -344,6 +395,15 @@ namespace gbe
           p->WHILE(src);
         }
         break;
+      case SEL_OP_BREAK:
+        {
+          const ir::LabelIndex label0(insn.index), label1(insn.index1);
+          const LabelPair labelPair(label0, label1);
+          const GenRegister src = ra->genReg(insn.src(0));
+          this->branchPos3.push_back(std::make_pair(labelPair, p->store.size()));
+          p->BREAK(src);
+        }
+        break;
       default: NOT_IMPLEMENTED;
     }
   }
@@ -3636,12 +3696,24 @@ namespace gbe
     }
   }
 
+  void GenContext::allocPerThreadCurbeReg(ir::Register reg) {
+    const uint32_t crossThreadSize = ALIGN(kernel->curbeSize, GEN_REG_SIZE);
+    const uint32_t offset = newCurbeEntry(GBE_CURBE_THREAD_ID, 0, GEN_REG_SIZE, GEN_REG_SIZE);
+    insertCurbeReg(reg, offset);
+    // newCurbeEntry offsets the curbe by one GRF (r0)
+    if (offset == crossThreadSize + GEN_REG_SIZE)
+      kernel->crossThreadCurbeSize = crossThreadSize;
+  }
+
   void GenContext::buildPatchList() {
 
     // After this point the vector is immutable. Sorting it will make
     // research faster
     std::sort(kernel->patches.begin(), kernel->patches.end());
     kernel->curbeSize = ALIGN(kernel->curbeSize, GEN_REG_SIZE);
+    // Nothing differs from one thread to another, they can all share the curbe
+    if (this->localIDInPrologue && kernel->getCurbeOffset(GBE_CURBE_THREAD_ID, 0) < 0)
+      kernel->crossThreadCurbeSize = kernel->curbeSize;
   }
 
   BVAR(OCL_OUTPUT_SEL_IR_AFTER_SELECT, false);
@@ -3673,6 +3745,7 @@ namespace gbe
     if (inProfilingMode) { // add the profiling prolog before do anything.
       this->profilingProlog();
     }
+    this->emitLocalID();
     this->emitStackPointer();
     this->clearFlagRegister();
     this->emitSLMOffset();
@@ -92,6 +92,12 @@ namespace gbe
     GenRegister checkFlagRegister(GenRegister flagReg);
     /*! Emit the per-lane stack pointer computation */
     virtual void emitStackPointer(void);
+    /*! Compute the local IDs from the thread ID instead of reading them from the curbe */
+    void emitLocalID(void);
+    /*! Tells if the device may let the prologue compute the local IDs */
+    virtual bool supportLocalIDInPrologue(void) const { return false; }
+    /*! Allocate the thread ID in its own GRF at the end of the curbe */
+    void allocPerThreadCurbeReg(ir::Register reg);
     /*! Emit the instructions */
     void emitInstructionStream(void);
     /*! Set the correct target values for the branches */
@@ -980,6 +980,7 @@ namespace gbe
   ALU2_BRA(ELSE)
   ALU2_BRA(ENDIF)
   ALU2_BRA(WHILE)
+  ALU2_BRA(BREAK)
   ALU2_BRA(BRD)
   ALU2_BRA(BRC)
 
@@ -994,6 +995,7 @@ namespace gbe
                insn.header.opcode == GEN_OPCODE_IF ||
                insn.header.opcode == GEN_OPCODE_BRC ||
                insn.header.opcode == GEN_OPCODE_WHILE ||
+               insn.header.opcode == GEN_OPCODE_BREAK ||
                insn.header.opcode == GEN_OPCODE_ELSE);
 
     if( insn.header.opcode == GEN_OPCODE_WHILE ){
@@ -1125,8 +1127,8 @@ namespace gbe
         assert(src0.type != GEN_TYPE_F);
         assert(src1.type != GEN_TYPE_F);
      } else {
-        assert(src0.type == GEN_TYPE_F);
-        assert(src1.type == GEN_TYPE_F);
+        assert(src0.type == GEN_TYPE_F || src0.type == GEN_TYPE_HF);
+        assert(src1.type == src0.type);
      }
 
      insn->header.destreg_or_condmod = function;
@@ -1163,7 +1165,7 @@ namespace gbe
      assert(dst.file == GEN_GENERAL_REGISTER_FILE);
      assert(src.file == GEN_GENERAL_REGISTER_FILE);
      assert(dst.hstride == GEN_HORIZONTAL_STRIDE_1 || dst.hstride == GEN_HORIZONTAL_STRIDE_0);
-     assert(src.type == GEN_TYPE_F);
+     assert(src.type == GEN_TYPE_F || src.type == GEN_TYPE_HF);
 
      insn->header.destreg_or_condmod = function;
      this->setHeader(insn);
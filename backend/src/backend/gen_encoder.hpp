@@ -156,6 +156,8 @@ namespace gbe
     void ENDIF(GenRegister src);
     /*! WHILE indexed instruction */
     void WHILE(GenRegister src);
+    /*! BREAK indexed instruction */
+    void BREAK(GenRegister src);
     /*! BRC indexed instruction */
     void BRC(GenRegister src);
     /*! BRD indexed instruction */
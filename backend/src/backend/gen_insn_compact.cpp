@@ -738,7 +738,8 @@ namespace gbe {
       // TODO support it
       return false;
     } else {
-      if(opcode == GEN_OPCODE_IF  || opcode == GEN_OPCODE_ENDIF || opcode == GEN_OPCODE_JMPI) return false;
+      if(opcode == GEN_OPCODE_IF  || opcode == GEN_OPCODE_ENDIF || opcode == GEN_OPCODE_JMPI ||
+         opcode == GEN_OPCODE_BREAK) return false;
 
       int control_index = compactControlBits(p, p->curr.quarterControl, p->curr.execWidth);
       if(control_index == -1) return false;
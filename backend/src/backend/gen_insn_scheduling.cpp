@@ -605,6 +605,7 @@ namespace gbe
           || node->insn.opcode == SEL_OP_ELSE
           || node->insn.opcode == SEL_OP_ENDIF
           || node->insn.opcode == SEL_OP_WHILE
+          || node->insn.opcode == SEL_OP_BREAK
           || node->insn.opcode == SEL_OP_READ_ARF
           || node->insn.opcode == SEL_OP_BARRIER
           || node->insn.opcode == SEL_OP_CALC_TIMESTAMP
@@ -424,9 +424,11 @@ namespace gbe
     bool hasLongType() const { return bHasLongType; }
     bool hasDoubleType() const { return bHasDoubleType; }
     bool hasHalfType() const { return bHasHalfType; }
+    bool hasHalfMath() const { return bHasHalfMath; }
     void setHasLongType(bool b) { bHasLongType = b; }
     void setHasDoubleType(bool b) { bHasDoubleType = b; }
     void setHasHalfType(bool b) { bHasHalfType = b; }
+    void setHasHalfMath(bool b) { bHasHalfMath = b; }
     bool hasLongRegRestrict() { return bLongRegRestrict; }
     void setLongRegRestrict(bool b) { bLongRegRestrict = b; }
     void setLdMsgOrder(uint32_t type)  { ldMsgOrder = type; }
@@ -669,6 +671,8 @@ namespace gbe
     void ENDIF(Reg src, ir::LabelIndex jip, ir::LabelIndex endifLabel = ir::LabelIndex(0));
     /*! WHILE indexed instruction */
     void WHILE(Reg src, ir::LabelIndex jip);
+    /*! BREAK indexed instruction */
+    void BREAK(Reg src, ir::LabelIndex jip, ir::LabelIndex uip);
     /*! BRD indexed instruction */
     void BRD(Reg src, ir::LabelIndex jip);
     /*! BRC indexed instruction */
@@ -867,6 +871,8 @@ namespace gbe
     bool bHasLongType;
     bool bHasDoubleType;
     bool bHasHalfType;
+    /*! HF operands are accepted by the math and round instructions */
+    bool bHasHalfMath;
     bool bLongRegRestrict;
     bool bHasSends;
     uint32_t ldMsgOrder;
@@ -911,7 +917,7 @@ namespace gbe
     maxInsnNum(ctx.getFunction().getLargestBlockSize()), dagPool(maxInsnNum),
     stateNum(0), vectorNum(0), bwdCodeGeneration(false), storeThreadMap(false),
     currAuxLabel(ctx.getFunction().labelNum()), bHas32X32Mul(false), bHasLongType(false),
-    bHasDoubleType(false), bHasHalfType(false), bLongRegRestrict(false), bHasSends(false),
+    bHasDoubleType(false), bHasHalfType(false), bHasHalfMath(false), bLongRegRestrict(false), bHasSends(false),
     ldMsgOrder(LD_MSG_ORDER_IVB), slowByteGather(false)
   {
     const ir::Function &fn = ctx.getFunction();
@@ -1357,6 +1363,13 @@ namespace gbe
     insn->index = jip.value();
   }
 
+  void Selection::Opaque::BREAK(Reg src, ir::LabelIndex jip, ir::LabelIndex uip) {
+    SelectionInstruction *insn = this->appendInsn(SEL_OP_BREAK, 0, 1);
+    insn->src(0) = src;
+    insn->index = jip.value();
+    insn->index1 = uip.value();
+  }
+
   void Selection::Opaque::CMP(uint32_t conditional, Reg src0, Reg src1, Reg dst) {
     SelectionInstruction *insn = this->appendInsn(SEL_OP_CMP, 1, 2);
     insn->src(0) = src0;
@@ -2800,6 +2813,7 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     this->opaque->setLdMsgOrder(LD_MSG_ORDER_SKL);
     this->opaque->setSlowByteGather(false);
     this->opaque->setHasHalfType(true);
+    this->opaque->setHasHalfMath(true);
     this->opaque->setHasSends(true);
     opt_features = SIOF_LOGICAL_SRCMOD;
   }
@@ -2812,6 +2826,7 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     this->opaque->setLdMsgOrder(LD_MSG_ORDER_SKL);
     this->opaque->setSlowByteGather(false);
     this->opaque->setHasHalfType(true);
+    this->opaque->setHasHalfMath(true);
     opt_features = SIOF_LOGICAL_SRCMOD | SIOF_OP_MOV_LONG_REG_RESTRICT;
   }
 
@@ -2822,6 +2837,7 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     this->opaque->setLdMsgOrder(LD_MSG_ORDER_SKL);
     this->opaque->setSlowByteGather(false);
     this->opaque->setHasHalfType(true);
+    this->opaque->setHasHalfMath(true);
     this->opaque->setHasSends(true);
     opt_features = SIOF_LOGICAL_SRCMOD;
   }
@@ -2834,6 +2850,7 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
     this->opaque->setLdMsgOrder(LD_MSG_ORDER_SKL);
     this->opaque->setSlowByteGather(false);
     this->opaque->setHasHalfType(true);
+    this->opaque->setHasHalfMath(true);
     opt_features = SIOF_LOGICAL_SRCMOD | SIOF_OP_MOV_LONG_REG_RESTRICT;
   }
 
@@ -3114,6 +3131,42 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
         return insnType;
     }
 
+    static bool isFloatOnly(const ir::Opcode opcode) {
+      switch (opcode) {
+        case ir::OP_RNDD: case ir::OP_RNDE: case ir::OP_RNDU: case ir::OP_RNDZ:
+        case ir::OP_COS: case ir::OP_SIN: case ir::OP_LOG: case ir::OP_EXP:
+        case ir::OP_SQR: case ir::OP_RSQ: case ir::OP_RCP:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    /*! Run a HF operation in float when the target can not do it natively */
+    INLINE void emitHalfInFloat(Selection::Opaque &sel, const ir::UnaryInstruction &insn,
+                                GenRegister dst, GenRegister src) const {
+      const bool isScalar = sel.isScalarReg(insn.getDst(0));
+      const GenRegister tmp = sel.selReg(sel.reg(ir::FAMILY_DWORD, isScalar), ir::TYPE_FLOAT);
+      const GenRegister unpacked = sel.unpacked_uw(sel.reg(ir::FAMILY_DWORD, isScalar));
+      sel.F16TO32(tmp, src);
+      switch (insn.getOpcode()) {
+        case ir::OP_RNDD: sel.RNDD(tmp, tmp); break;
+        case ir::OP_RNDE: sel.RNDE(tmp, tmp); break;
+        case ir::OP_RNDU: sel.RNDU(tmp, tmp); break;
+        case ir::OP_RNDZ: sel.RNDZ(tmp, tmp); break;
+        case ir::OP_COS: sel.MATH(tmp, GEN_MATH_FUNCTION_COS, tmp); break;
+        case ir::OP_SIN: sel.MATH(tmp, GEN_MATH_FUNCTION_SIN, tmp); break;
+        case ir::OP_LOG: sel.MATH(tmp, GEN_MATH_FUNCTION_LOG, tmp); break;
+        case ir::OP_EXP: sel.MATH(tmp, GEN_MATH_FUNCTION_EXP, tmp); break;
+        case ir::OP_SQR: sel.MATH(tmp, GEN_MATH_FUNCTION_SQRT, tmp); break;
+        case ir::OP_RSQ: sel.MATH(tmp, GEN_MATH_FUNCTION_RSQ, tmp); break;
+        case ir::OP_RCP: sel.MATH(tmp, GEN_MATH_FUNCTION_INV, tmp); break;
+        default: NOT_SUPPORTED;
+      }
+      sel.F32TO16(unpacked, tmp);
+      sel.MOV(dst, GenRegister::retype(unpacked, GEN_TYPE_HF));
+    }
+
     INLINE bool emitOne(Selection::Opaque &sel, const ir::UnaryInstruction &insn, bool &markChildren) const {
       const ir::Opcode opcode = insn.getOpcode();
       const ir::Type insnType = insn.getType();
@@ -3125,6 +3178,11 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
           sel.curr.predicate = GEN_PREDICATE_NONE;
           sel.curr.noMask = 1;
         }
+        if (insnType == ir::TYPE_HALF && !sel.hasHalfMath() && isFloatOnly(opcode)) {
+          this->emitHalfInFloat(sel, insn, dst, src);
+          sel.pop();
+          return true;
+        }
         switch (opcode) {
           case ir::OP_ABS:
             {
@@ -3285,6 +3343,9 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
         }
         unpacked = GenRegister::retype(unpacked, getGenType(type));
         sel.MOV(dst, unpacked);
+      } else if (type == TYPE_HALF && sel.hasHalfMath()) {
+        GBE_ASSERT(op != OP_REM);
+        sel.MATH(dst, GEN_MATH_FUNCTION_FDIV, src0, src1);
       } else if (type == TYPE_HALF) {
         ir::Register reg = sel.reg(FAMILY_DWORD, isUniform);
         GenRegister tmp0 = sel.selReg(sel.reg(FAMILY_DWORD, isUniform), ir::TYPE_FLOAT);
@@ -3429,8 +3490,18 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
         GenRegister src0 = sel.selReg(insn.getSrc(0), type);
         GenRegister src1 = sel.selReg(insn.getSrc(1), type);
 
-        if(type == TYPE_FLOAT) {
+        if(type == TYPE_FLOAT || (type == TYPE_HALF && sel.hasHalfMath())) {
           sel.MATH(dst, GEN_MATH_FUNCTION_POW, src0, src1);
+        } else if (type == TYPE_HALF) {
+          const bool isUniform = sel.isScalarReg(insn.getDst(0));
+          GenRegister tmp0 = sel.selReg(sel.reg(FAMILY_DWORD, isUniform), ir::TYPE_FLOAT);
+          GenRegister tmp1 = sel.selReg(sel.reg(FAMILY_DWORD, isUniform), ir::TYPE_FLOAT);
+          GenRegister unpacked = sel.unpacked_uw(sel.reg(FAMILY_DWORD, isUniform));
+          sel.F16TO32(tmp0, src0);
+          sel.F16TO32(tmp1, src1);
+          sel.MATH(tmp0, GEN_MATH_FUNCTION_POW, tmp0, tmp1);
+          sel.F32TO16(unpacked, tmp0);
+          sel.MOV(dst, GenRegister::retype(unpacked, GEN_TYPE_HF));
         } else {
           NOT_IMPLEMENTED;
         }
@@ -7690,6 +7761,9 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
       } else if(opcode == OP_WHILE) {
         const Register pred = insn.getPredicateIndex();
         const LabelIndex jip = insn.getLabelIndex();
+        // The BREAKs of this loop jump to the WHILE itself.
+        if(insn.getParent()->breakLabel != 0)
+          sel.LABEL(insn.getParent()->breakLabel);
         sel.push();
           sel.curr.physicalFlag = 0;
           sel.curr.flagIndex = (uint64_t)pred;
@@ -7699,6 +7773,18 @@ extern bool OCL_DEBUGINFO; // first defined by calling BVAR in program.cpp
           sel.WHILE(GenRegister::immd(0), jip);
           sel.curr.inversePredicate = 0;
         sel.pop();
+      } else if(opcode == OP_BREAK) {
+        const Register pred = insn.getPredicateIndex();
+        const LabelIndex label = insn.getLabelIndex();
+        sel.push();
+          sel.curr.physicalFlag = 0;
+          sel.curr.flagIndex = (uint64_t)pred;
+          sel.curr.externFlag = 1;
+          sel.curr.inversePredicate = insn.getInversePredicated();
+          sel.curr.predicate = GEN_PREDICATE_NORMAL;
+          sel.BREAK(GenRegister::immd(0), label, label);
+          sel.curr.inversePredicate = 0;
+        sel.pop();
       } else
         NOT_IMPLEMENTED;
 
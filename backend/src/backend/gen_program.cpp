@@ -73,13 +73,19 @@
 namespace gbe {
 
   GenKernel::GenKernel(const std::string &name, uint32_t deviceID) :
-    Kernel(name), deviceID(deviceID), insns(NULL), insnNum(0)
+    Kernel(name), deviceID(deviceID), insns(NULL), insnNum(0), ownInsns(true)
   {}
-  GenKernel::~GenKernel(void) { GBE_SAFE_DELETE_ARRAY(insns); }
+  GenKernel::~GenKernel(void) { if (ownInsns) GBE_SAFE_DELETE_ARRAY(insns); }
   const char *GenKernel::getCode(void) const { return (const char*) insns; }
   void GenKernel::setCode(const char * ins, size_t size) {
     insns = (GenInstruction *)ins;
     insnNum = size / sizeof(GenInstruction);
+    ownInsns = true;
+  }
+  void GenKernel::setCodeInPlace(const char * ins, size_t size) {
+    insns = (GenInstruction *)ins;
+    insnNum = size / sizeof(GenInstruction);
+    ownInsns = false;
   }
   uint32_t GenKernel::getCodeSize(void) const { return insnNum * sizeof(GenInstruction); }
 
@@ -223,6 +229,7 @@ namespace gbe {
 
     ctx->setASMFileName(this->asm_file_name);
 
+    const bool trySimd16 = codeGenStrategy[codeGen].simdWidth == 16;
     for (; codeGen < codeGenNum; ++codeGen) {
       const uint32_t simdWidth = codeGenStrategy[codeGen].simdWidth;
       const bool limitRegisterPressure = codeGenStrategy[codeGen].limitRegisterPressure;
@@ -249,6 +256,9 @@ namespace gbe {
       } else
         GBE_ASSERT(!(ctx->getErrCode() == OUT_OF_RANGE_IF_ENDIF && ctx->getIFENDIFFix()));
     }
+    // Let the program know register allocation pushed the kernel to SIMD8
+    if (trySimd16 && (kernel == NULL || kernel->getSIMDWidth() != 16))
+      this->simd16Failed.insert(name);
 
     //GBE_ASSERTM(kernel != NULL, "Fail to compile kernel, may need to increase reserved registers for spilling.");
     return kernel;
@@ -271,17 +281,16 @@ namespace gbe {
     GBHI_GLK = 8,
     GBHI_MAX,
   };
-#define GEN_BINARY_VERSION  1
   static const unsigned char gen_binary_header[GBHI_MAX][GEN_BINARY_HEADER_LENGTH]= \
-                                             {{GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'Y', 'T'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'I', 'V', 'B'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'H', 'S', 'W'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'C', 'H', 'V'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'D', 'W'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'S', 'K', 'L'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'X', 'T'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'K', 'B', 'T'},
-                                              {GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'G', 'L', 'K'}
+                                             {{GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'Y', 'T'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'I', 'V', 'B'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'H', 'S', 'W'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'C', 'H', 'V'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'D', 'W'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'S', 'K', 'L'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'B', 'X', 'T'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'K', 'B', 'T'},
+                                              {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C', 'G', 'L', 'K'}
                                               };
 
 #define FILL_GEN_HEADER(binary, index)  do {int i = 0; do {*(binary+i) = gen_binary_header[index][i]; i++; }while(i < GEN_BINARY_HEADER_LENGTH);}while(0)
@@ -336,7 +345,6 @@ namespace gbe {
 
   static gbe_program genProgramNewFromBinary(uint32_t deviceID, const char *binary, size_t size) {
     using namespace gbe;
-    std::string binary_content;
 
     if(size < GEN_BINARY_HEADER_LENGTH)
       return NULL;
@@ -346,11 +354,9 @@ namespace gbe {
       return NULL;
     }
 
-    binary_content.assign(binary+GEN_BINARY_HEADER_LENGTH, size-GEN_BINARY_HEADER_LENGTH);
     GenProgram *program = GBE_NEW(GenProgram, deviceID);
-    std::istringstream ifs(binary_content, std::ostringstream::binary);
 
-    if (!program->deserializeFromBin(ifs)) {
+    if (!program->deserializeFromImage(binary+GEN_BINARY_HEADER_LENGTH, size-GEN_BINARY_HEADER_LENGTH)) {
       delete program;
       return NULL;
     }
@@ -474,6 +480,12 @@ namespace gbe {
     }
   }
 
+  /*! Both options allow the math library to take its native fast paths */
+  static bool isRelaxedMathOption(const char *options) {
+    return strstr(options, "-cl-fast-relaxed-math") != NULL ||
+           strstr(options, "-cl-unsafe-math-optimizations") != NULL;
+  }
+
   static gbe_program genProgramNewFromLLVM(uint32_t deviceID,
                                            const void* module,
                                            const void* llvm_ctx,
@@ -487,7 +499,7 @@ namespace gbe {
     using namespace gbe;
     uint32_t fast_relaxed_math = 0;
     if (options != NULL)
-      if (strstr(options, "-cl-fast-relaxed-math") != NULL)
+      if (isRelaxedMathOption(options))
         fast_relaxed_math = 1;
 
     GenProgram *program = GBE_NEW(GenProgram, deviceID, module, llvm_ctx, asm_file_name, fast_relaxed_math);
@@ -593,7 +605,7 @@ namespace gbe {
         optLevel = 0;
 
       if (options != NULL)
-        if (strstr(options, "-cl-fast-relaxed-math") != NULL)
+        if (isRelaxedMathOption(options))
           fast_relaxed_math = 1;
 
       char *options_str = (char *)malloc(sizeof(char) * (strlen(options) + 1));
@@ -45,6 +45,8 @@ namespace gbe
     virtual const char *getCode(void) const;
     /*! Set the instruction stream (to be implemented) */
     virtual void setCode(const char *, size_t size);
+    /*! Implements base class */
+    virtual void setCodeInPlace(const char *, size_t size);
     /*! Implements get the code size */
     virtual uint32_t getCodeSize(void) const;
     /*! Implements printStatus*/
@@ -52,6 +54,7 @@ namespace gbe
     uint32_t deviceID;      //!< Current device ID
     GenInstruction *insns; //!< Instruction stream
     uint32_t insnNum;      //!< Number of instructions
+    bool ownInsns;         //!< False if the stream lives in the program binary
     GBE_CLASS(GenKernel);  //!< Use custom allocators
   };
 
@@ -74,6 +77,8 @@ namespace gbe
     virtual Kernel *allocateKernel(const std::string &name) {
       return GBE_NEW(GenKernel, name, deviceID);
     }
+    /*! The ASM dump file name does not outlive the build */
+    virtual bool canDeferCodegen(void) const { return asm_file_name == NULL; }
     void* module;
     void* llvm_ctx;
     const char* asm_file_name;
@@ -277,11 +277,19 @@ namespace gbe
       payloadInterval.push_back(interval);
     }
     std::sort(payloadInterval.begin(), payloadInterval.end(), cmp<false>);
+    bool hasThreadID = false;
     for(auto interval : payloadInterval) {
       if (interval->maxID < 0)
         continue;
+      // Keep the only per thread value after the data shared by all the threads
+      if (ctx.hasLocalIDInPrologue() && interval->reg == ir::ocl::threadid) {
+        hasThreadID = true;
+        continue;
+      }
       ctx.allocCurbeReg(interval->reg);
     }
+    if (hasThreadID)
+      ctx.allocPerThreadCurbeReg(ir::ocl::threadid);
   }
 
   INLINE float IDFitness(int a, int b) {
@@ -951,6 +959,9 @@ namespace gbe
        // avoid to spill those temporary registers here.
        if (ctx.getSimdWidth() == 16 && reg.value() >= ctx.getFunction().getRegisterFile().regNum())
          return;
+       // The prologue writes the local IDs before any spill code may run
+       if (ctx.isPrologueLocalID(reg))
+         return;
 
        if (((regSize == ctx.getSimdWidth()/8 * GEN_REG_SIZE && family == ir::FAMILY_DWORD)
           || (regSize == 2 * ctx.getSimdWidth()/8 * GEN_REG_SIZE && family == ir::FAMILY_QWORD))
@@ -976,6 +987,9 @@ namespace gbe
         ctx.getSimdWidth() == 16)
       return false;
 
+    if (ctx.isPrologueLocalID(interval.reg))
+      return false;
+
     ir::RegisterFamily family = ctx.sel->getRegisterFamily(interval.reg);
     // we currently only support DWORD/QWORD spill
     if(family != ir::FAMILY_DWORD && family != ir::FAMILY_QWORD)
@@ -1499,6 +1513,26 @@ do { \
     }
 #undef ADD_CURB_REG_FOR_PROFILING
 
+    // The prologue computes the local IDs from the thread ID and the local
+    // sizes, so all of them are live when the kernel starts
+    if (ctx.hasLocalIDInPrologue()) {
+      const ir::Register lids[] = {ocl::lid0, ocl::lid1, ocl::lid2};
+      const ir::Register inputs[] = {ocl::threadid, ocl::lsize0, ocl::lsize1};
+      bool hasLocalID = false;
+      for (auto reg : lids) {
+        if (this->intervals[reg].maxID == -INT_MAX)
+          continue;
+        this->intervals[reg].minID = 0;
+        hasLocalID = true;
+      }
+      if (hasLocalID) {
+        for (auto reg : inputs) {
+          this->intervals[reg].minID = 0;
+          this->intervals[reg].maxID = std::max(this->intervals[reg].maxID, 1);
+        }
+      }
+    }
+
     this->intervals[ocl::retVal].minID = INT_MAX;
     this->intervals[ocl::retVal].maxID = -INT_MAX;
 
@@ -37,6 +37,7 @@
 #include "llvm/llvm_to_gen.hpp"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/Support/Threading.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/IR/LLVMContext.h"
@@ -51,6 +52,10 @@
 #include <iostream>
 #include <unistd.h>
 #include <mutex>
+#include <atomic>
+#include <set>
+#include <sys/stat.h>
+#include <errno.h>
 
 #ifdef GBE_COMPILER_AVAILABLE
 
@@ -59,6 +64,8 @@
 #include <clang/Frontend/CompilerInvocation.h>
 #include <clang/Basic/DiagnosticOptions.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Basic/Version.h>
 #include <clang/Basic/TargetInfo.h>
 #include <clang/Basic/TargetOptions.h>
 #include <llvm/ADT/IntrusiveRefCntPtr.h>
@@ -78,7 +85,7 @@
 namespace gbe {
 
   Kernel::Kernel(const std::string &name) :
-    name(name), args(NULL), argNum(0), curbeSize(0), stackSize(0), useSLM(false),
+    name(name), args(NULL), argNum(0), curbeSize(0), crossThreadCurbeSize(0), stackSize(0), useSLM(false),
         slmSize(0), ctx(NULL), samplerSet(NULL), imageSet(NULL), printfSet(NULL),
         profilingInfo(NULL), useDeviceEnqueue(false) {}
 
@@ -99,20 +106,53 @@ namespace gbe {
   }
 
   Program::Program(uint32_t fast_relaxed_math) : fast_relaxed_math(fast_relaxed_math), 
+                               lazyUnit(NULL),
+                               image(NULL),
+                               oclVersion(0),
                                constantSet(NULL),
                                relocTable(NULL) {}
   Program::~Program(void) {
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it)
-      GBE_DELETE(it->second);
+      if (it->second) GBE_DELETE(it->second);
+#ifdef GBE_COMPILER_AVAILABLE
+    if (lazyUnit) delete lazyUnit;
+#endif
+    if (image) GBE_DELETE_ARRAY(image);
     if (constantSet) delete constantSet;
     if (relocTable) delete relocTable;
   }
 
+  /*! Read only stream over a memory range, so that binaries are parsed in
+   *  place instead of being copied into a string stream first */
+  class MemoryStreamBuf : public std::streambuf
+  {
+  public:
+    MemoryStreamBuf(const char *data, size_t size) {
+      char *begin = const_cast<char *>(data);
+      this->setg(begin, begin, begin + size);
+    }
+  protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                             std::ios_base::openmode which = std::ios_base::in) {
+      char *pos = dir == std::ios_base::beg ? this->eback() :
+                  dir == std::ios_base::cur ? this->gptr() : this->egptr();
+      pos += off;
+      if (pos < this->eback() || pos > this->egptr())
+        return pos_type(off_type(-1));
+      this->setg(this->eback(), pos, this->egptr());
+      return pos_type(pos - this->eback());
+    }
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) {
+      return this->seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+  };
+
 #ifdef GBE_COMPILER_AVAILABLE
   BVAR(OCL_OUTPUT_GEN_IR, false);
   BVAR(OCL_STRICT_CONFORMANCE, true);
   IVAR(OCL_PROFILING_LOG, 0, 0, 1); // Int for different profiling types.
   BVAR(OCL_OUTPUT_BUILD_LOG, false);
+  BVAR(OCL_LAZY_CODEGEN, false);
 
   bool Program::buildFromLLVMModule(const void* module,
                                               std::string &error,
@@ -133,55 +173,172 @@ namespace gbe {
     if(!unit->getValid()) {
       delete unit;   //clear unit
       unit = new ir::Unit();
+      optLevel = 0;
       //suppose file exists and llvmToGen will not return false.
-      llvmToGen(*unit, module, 0, strictMath, OCL_PROFILING_LOG, error);
+      llvmToGen(*unit, module, optLevel, strictMath, OCL_PROFILING_LOG, error);
     }
+    // In lazy mode only the Gen IR is produced here, the kernels are
+    // generated from the kept unit the first time they are requested
+    const bool deferCodegen = OCL_LAZY_CODEGEN && this->canDeferCodegen();
+    this->simd16Failed.clear();
     if(unit->getValid()){
       std::string error2;
-      if (this->buildFromUnit(*unit, error2)){
+      if (this->buildFromUnit(*unit, error2, deferCodegen)){
         ret = true;
       }
       error = error + error2;
     }
-    delete unit;
+    // The forced unrolling only estimates the register pressure, back off
+    // when it still made some kernel with a forced loop lose SIMD16
+    bool unrollFailed = false;
+    for (const auto &name : this->simd16Failed)
+      unrollFailed = unrollFailed || unit->getForcedUnroll(name);
+    if (!deferCodegen && unit->getValid() && unrollFailed)
+      ret = this->buildWithoutForcedUnroll(module, optLevel, strictMath, ret, error);
+    if (ret && deferCodegen && !kernels.empty())
+      lazyUnit = unit;
+    else
+      delete unit;
     return ret;
   }
 
-  bool Program::buildFromUnit(const ir::Unit &unit, std::string &error) {
+  Kernel *Program::buildKernel(const ir::Unit &unit, const std::string &name, std::string &error) {
+    bool strictMath = true;
+    if (fast_relaxed_math || !OCL_STRICT_CONFORMANCE)
+      strictMath = false;
+
+    Kernel *kernel = this->compileKernel(unit, name, !strictMath, OCL_PROFILING_LOG);
+    if (!kernel) {
+      error +=  name;
+      error += ":(GBE): error: failed in Gen backend.\n";
+      if (OCL_OUTPUT_BUILD_LOG)
+        llvm::errs() << error;
+      return NULL;
+    }
+    const ir::Function *fn = unit.getFunction(name);
+    kernel->setSamplerSet(fn->getSamplerSet());
+    kernel->setProfilingInfo(new ir::ProfilingInfo(*unit.getProfilingInfo()));
+    kernel->setImageSet(fn->getImageSet());
+    kernel->setPrintfSet(fn->getPrintfSet());
+    kernel->setCompileWorkGroupSize(fn->getCompileWorkGroupSize());
+    kernel->setFunctionAttributes(fn->getFunctionAttributes());
+    return kernel;
+  }
+
+  bool Program::buildWithoutForcedUnroll(const void* module, int optLevel, bool strictMath,
+                                         bool built, std::string &error) {
+    ir::Unit *unit = new ir::Unit();
+    std::string error2;
+    if (llvmToGen(*unit, module, optLevel, strictMath, OCL_PROFILING_LOG, error2, false) == false ||
+        !unit->getValid()) {
+      delete unit;
+      return built;
+    }
+
+    map<std::string, Kernel*> plainKernels;
+    bool plainBuilt = true;
+    uint32_t simd16Num = 0, plainSimd16Num = 0;
+    for (const auto &pair : unit->getFunctionSet()) {
+      Kernel *kernel = this->buildKernel(*unit, pair.first, error2);
+      if (!kernel) {
+        plainBuilt = false;
+        break;
+      }
+      plainKernels.insert(std::make_pair(pair.first, kernel));
+      if (kernel->getSIMDWidth() == 16)
+        plainSimd16Num++;
+    }
+    for (const auto &pair : kernels)
+      if (pair.second && pair.second->getSIMDWidth() == 16)
+        simd16Num++;
+
+    // Only trade the unrolled kernels for strictly better ones
+    if (!plainBuilt || (built && plainSimd16Num <= simd16Num)) {
+      for (const auto &pair : plainKernels)
+        GBE_DELETE(pair.second);
+      delete unit;
+      return built;
+    }
+
+    for (const auto &pair : kernels)
+      if (pair.second) GBE_DELETE(pair.second);
+    kernels.clear();
+    kernels.swap(plainKernels);
+    this->setUnitGlobals(*unit);
+    delete unit;
+    return true;
+  }
+
+  void Program::setUnitGlobals(const ir::Unit &unit) {
+    if (constantSet) delete constantSet;
+    if (relocTable) delete relocTable;
     constantSet = new ir::ConstantSet(unit.getConstantSet());
     relocTable = new ir::RelocTable(unit.getRelocTable());
     blockFuncs = unit.blockFuncs;
+    oclVersion = unit.getOclVersion();
+  }
+
+  bool Program::buildFromUnit(const ir::Unit &unit, std::string &error, bool deferCodegen) {
+    this->setUnitGlobals(unit);
     const auto &set = unit.getFunctionSet();
     const uint32_t kernelNum = set.size();
     if (OCL_OUTPUT_GEN_IR) std::cout << unit;
     if (kernelNum == 0) return true;
 
-    bool strictMath = true;
-    if (fast_relaxed_math || !OCL_STRICT_CONFORMANCE)
-      strictMath = false;
-
     for (const auto &pair : set) {
       const std::string &name = pair.first;
-      Kernel *kernel = this->compileKernel(unit, name, !strictMath, OCL_PROFILING_LOG);
-      if (!kernel) {
-        error +=  name;
-        error += ":(GBE): error: failed in Gen backend.\n";
-        if (OCL_OUTPUT_BUILD_LOG)
-          llvm::errs() << error;
-        return false;
+      if (deferCodegen) {
+        kernels.insert(std::make_pair(name, (Kernel *) NULL));
+        continue;
       }
-      kernel->setSamplerSet(pair.second->getSamplerSet());
-      kernel->setProfilingInfo(new ir::ProfilingInfo(*unit.getProfilingInfo()));
-      kernel->setImageSet(pair.second->getImageSet());
-      kernel->setPrintfSet(pair.second->getPrintfSet());
-      kernel->setCompileWorkGroupSize(pair.second->getCompileWorkGroupSize());
-      kernel->setFunctionAttributes(pair.second->getFunctionAttributes());
+      Kernel *kernel = this->buildKernel(unit, name, error);
+      if (!kernel)
+        return false;
       kernels.insert(std::make_pair(name, kernel));
     }
     return true;
   }
 #endif
 
+  Kernel *Program::buildLazyKernel(const std::string &name) {
+    std::lock_guard<std::mutex> lock(lazyMutex);
+    map<std::string, Kernel*>::iterator it = kernels.find(name);
+    if (it == kernels.end())
+      return NULL;
+    if (it->second == NULL && image != NULL) {
+      const std::pair<uint32_t, uint32_t> &range = imageKernels[name];
+      Kernel *ker = this->allocateKernel(name);
+      if (ker->deserializeFromImage(image + range.first, range.second) != range.second) {
+        GBE_DELETE(ker);
+        ker = NULL;
+      }
+      it->second = ker;
+    }
+#ifdef GBE_COMPILER_AVAILABLE
+    if (it->second == NULL && lazyUnit != NULL && !lazyFailed.contains(name)) {
+      std::string error;
+      it->second = this->buildKernel(*lazyUnit, name, error);
+      // The build already returned, the log is handed with the failed kernel
+      if (it->second == NULL) {
+        lazyFailed.insert(name);
+        lazyLog += error;
+      }
+    }
+#endif
+    return it->second;
+  }
+
+  size_t Program::takeLazyLog(char *log, size_t size) {
+    std::lock_guard<std::mutex> lock(lazyMutex);
+    size_t len = 0;
+    if (log != NULL && size > 0) {
+      len = lazyLog.copy(log, size - 1, 0);
+      log[len] = '\0';
+    }
+    lazyLog.clear();
+    return len;
+  }
+
 #define OUT_UPDATE_SZ(elt) SERIALIZE_OUT(elt, outs, ret_size)
 #define IN_UPDATE_SZ(elt) DESERIALIZE_IN(elt, ins, total_size)
 
@@ -191,7 +348,15 @@ namespace gbe {
     uint32_t has_constset = 0;
     uint32_t has_relocTable = 0;
 
+    // The binary holds every kernel, generate the ones still deferred
+    if (this->isLazy()) {
+      for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it)
+        if (this->buildLazyKernel(it->first) == NULL)
+          return 0;
+    }
+
     OUT_UPDATE_SZ(magic_begin);
+    OUT_UPDATE_SZ(oclVersion);
 
     if (constantSet) {
       has_constset = 1;
@@ -217,13 +382,30 @@ namespace gbe {
       OUT_UPDATE_SZ(has_relocTable);
     }
 
-    OUT_UPDATE_SZ(ker_num);
+    // Serialize the kernels aside first, the table in front of them gives
+    // their sizes so that a loader can find any kernel without parsing the
+    // others
+    vector<std::string> kernelBins;
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
-      uint32_t sz = it->second->serializeToBin(outs);
-      if (!sz)
+      std::ostringstream oss;
+      if (!it->second->serializeToBin(oss))
         return 0;
+      kernelBins.push_back(oss.str());
+    }
 
-      ret_size += sz;
+    OUT_UPDATE_SZ(ker_num);
+    uint32_t i = 0;
+    for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it, ++i) {
+      uint32_t sz = it->first.size();
+      OUT_UPDATE_SZ(sz);
+      outs.write(it->first.c_str(), it->first.size());
+      ret_size += sizeof(char)*it->first.size();
+      sz = kernelBins[i].size();
+      OUT_UPDATE_SZ(sz);
+    }
+    for (i = 0; i < kernelBins.size(); i++) {
+      outs.write(kernelBins[i].c_str(), kernelBins[i].size());
+      ret_size += kernelBins[i].size();
     }
 
     OUT_UPDATE_SZ(magic_end);
@@ -232,7 +414,8 @@ namespace gbe {
     return ret_size;
   }
 
-  uint32_t Program::deserializeFromBin(std::istream& ins) {
+  uint32_t Program::deserializeHeader(std::istream& ins,
+                                      vector<std::pair<std::string, uint32_t>> &kernelTable) {
     uint32_t total_size = 0;
     int has_constset = 0;
     uint32_t ker_num;
@@ -243,6 +426,8 @@ namespace gbe {
     if (magic != magic_begin)
       return 0;
 
+    IN_UPDATE_SZ(oclVersion);
+
     IN_UPDATE_SZ(has_constset);
     if(has_constset) {
       constantSet = new ir::ConstantSet;
@@ -266,14 +451,36 @@ namespace gbe {
     }
 
     IN_UPDATE_SZ(ker_num);
-
     for (uint32_t i = 0; i < ker_num; i++) {
+      uint32_t name_len, ker_serial_sz;
+      IN_UPDATE_SZ(name_len);
+      std::string name(name_len, '\0');
+      ins.read(&name[0], name_len*sizeof(char));
+      total_size += sizeof(char)*name_len;
+      IN_UPDATE_SZ(ker_serial_sz);
+      if (!ins)
+        return 0;
+      kernelTable.push_back(std::make_pair(name, ker_serial_sz));
+    }
+
+    return total_size;
+  }
+
+  uint32_t Program::deserializeFromBin(std::istream& ins) {
+    vector<std::pair<std::string, uint32_t>> kernelTable;
+    uint32_t magic;
+    uint32_t total_size = this->deserializeHeader(ins, kernelTable);
+    if (total_size == 0)
+      return 0;
+
+    for (uint32_t i = 0; i < kernelTable.size(); i++) {
       uint32_t ker_serial_sz;
-      std::string ker_name; // Just a empty name here.
-      Kernel* ker = allocateKernel(ker_name);
+      Kernel* ker = allocateKernel(kernelTable[i].first);
 
-      if(!(ker_serial_sz = ker->deserializeFromBin(ins)))
+      if((ker_serial_sz = ker->deserializeFromBin(ins)) != kernelTable[i].second) {
+        GBE_DELETE(ker);
         return 0;
+      }
 
       kernels.insert(std::make_pair(ker->getName(), ker));
       total_size += ker_serial_sz;
@@ -291,6 +498,41 @@ namespace gbe {
     return total_size;
   }
 
+  bool Program::deserializeFromImage(const char *binary, size_t size) {
+    // Keep a single copy of the binary: the kernels are parsed from it on
+    // demand and their code is used in place
+    image = GBE_NEW_ARRAY_NO_ARG(char, size);
+    std::memcpy(image, binary, size);
+
+    MemoryStreamBuf buf(image, size);
+    std::istream ins(&buf);
+    vector<std::pair<std::string, uint32_t>> kernelTable;
+    uint32_t magic;
+    uint32_t total_size = this->deserializeHeader(ins, kernelTable);
+    if (total_size == 0)
+      return false;
+
+    for (uint32_t i = 0; i < kernelTable.size(); i++) {
+      if (total_size + kernelTable[i].second > size)
+        return false;
+      kernels.insert(std::make_pair(kernelTable[i].first, (Kernel *) NULL));
+      imageKernels[kernelTable[i].first] = std::make_pair(total_size, kernelTable[i].second);
+      total_size += kernelTable[i].second;
+    }
+
+    ins.seekg(total_size);
+    IN_UPDATE_SZ(magic);
+    if (!ins || magic != magic_end)
+      return false;
+
+    uint32_t total_bytes;
+    IN_UPDATE_SZ(total_bytes);
+    if (!ins || total_bytes + sizeof(total_size) != total_size)
+      return false;
+
+    return true;
+  }
+
   uint32_t Kernel::serializeToBin(std::ostream& outs) {
     unsigned int i;
     uint32_t ret_size = 0;
@@ -352,6 +594,7 @@ namespace gbe {
     }
 
     OUT_UPDATE_SZ(curbeSize);
+    OUT_UPDATE_SZ(crossThreadCurbeSize);
     OUT_UPDATE_SZ(simdWidth);
     OUT_UPDATE_SZ(stackSize);
     OUT_UPDATE_SZ(scratchSize);
@@ -361,7 +604,7 @@ namespace gbe {
     OUT_UPDATE_SZ(compileWgSize[1]);
     OUT_UPDATE_SZ(compileWgSize[2]);
     /* samplers. */
-    if (!samplerSet->empty()) {   //samplerSet is always valid, allocated in Function::Function
+    if (samplerSet && !samplerSet->empty()) {   //NULL when deserialized without samplers
       has_samplerset = 1;
       OUT_UPDATE_SZ(has_samplerset);
       uint32_t sz = samplerSet->serializeToBin(outs);
@@ -374,7 +617,7 @@ namespace gbe {
     }
 
     /* images. */
-    if (!imageSet->empty()) {   //imageSet is always valid, allocated in Function::Function
+    if (imageSet && !imageSet->empty()) {   //NULL when deserialized without images
       has_imageset = 1;
       OUT_UPDATE_SZ(has_imageset);
       uint32_t sz = imageSet->serializeToBin(outs);
@@ -399,6 +642,16 @@ namespace gbe {
   }
 
   uint32_t Kernel::deserializeFromBin(std::istream& ins) {
+    return this->deserialize(ins, NULL);
+  }
+
+  uint32_t Kernel::deserializeFromImage(const char *image, uint32_t size) {
+    MemoryStreamBuf buf(image, size);
+    std::istream ins(&buf);
+    return this->deserialize(ins, image);
+  }
+
+  uint32_t Kernel::deserialize(std::istream& ins, const char *image) {
     uint32_t total_size = 0;
     int has_samplerset = 0;
     int has_imageset = 0;
@@ -483,6 +736,7 @@ namespace gbe {
     }
 
     IN_UPDATE_SZ(curbeSize);
+    IN_UPDATE_SZ(crossThreadCurbeSize);
     IN_UPDATE_SZ(simdWidth);
     IN_UPDATE_SZ(stackSize);
     IN_UPDATE_SZ(scratchSize);
@@ -519,7 +773,11 @@ namespace gbe {
       imageSet = NULL;
 
     IN_UPDATE_SZ(code_size);
-    if (code_size) {
+    if (code_size && image) {
+      setCodeInPlace(image + total_size, code_size);
+      ins.seekg(code_size, std::ios_base::cur);
+      total_size += sizeof(char)*code_size;
+    } else if (code_size) {
       char* code = GBE_NEW_ARRAY_NO_ARG(char, code_size);
       ins.read(code, code_size*sizeof(char));
       total_size += sizeof(char)*code_size;
@@ -552,7 +810,8 @@ namespace gbe {
     }
 
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
-      it->second->printStatus(indent + 4, outs);
+      if (it->second)
+        it->second->printStatus(indent + 4, outs);
     }
 
     outs << spaces << "================ End Program ================" << "\n";
@@ -567,6 +826,7 @@ namespace gbe {
     outs << spaces << "+++++++++++ Begin Kernel +++++++++++" << "\n";
     outs << spaces_nl << "Kernel Name: " << name << "\n";
     outs << spaces_nl << "  curbeSize: " << curbeSize << "\n";
+    outs << spaces_nl << "  crossThreadCurbeSize: " << crossThreadCurbeSize << "\n";
     outs << spaces_nl << "  simdWidth: " << simdWidth << "\n";
     outs << spaces_nl << "  stackSize: " << stackSize << "\n";
     outs << spaces_nl << "  scratchSize: " << scratchSize << "\n";
@@ -632,16 +892,15 @@ namespace gbe {
     }
 
     args.push_back("-cl-kernel-arg-info");
-    // The ParseCommandLineOptions used for mllvm args can not be used with multithread
-    // and GVN now have a 100 inst limit on block scan. Now only pass a bigger limit
-    // for each context only once, this can also fix multithread bug.
+    // GVN now have a 100 inst limit on block scan, pass a bigger limit. The
+    // llvm options are global and the ParseCommandLineOptions used for mllvm
+    // args is not thread safe, so set it once before any build uses it.
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
-    static bool ifsetllvm = false;
-    if(!ifsetllvm) {
-      args.push_back("-mllvm");
-      args.push_back("-memdep-block-scan-limit=200");
-      ifsetllvm = true;
-    }
+    static std::once_flag llvmOptionsOnce;
+    std::call_once(llvmOptionsOnce, [] {
+      const char *llvmArgs[] = {"beignet", "-memdep-block-scan-limit=200"};
+      llvm::cl::ParseCommandLineOptions(2, llvmArgs);
+    });
 #endif
 #ifdef GEN7_SAMPLER_CLAMP_BORDER_WORKAROUND
     args.push_back("-DGEN7_SAMPLER_CLAMP_BORDER_WORKAROUND");
@@ -809,6 +1068,133 @@ namespace gbe {
   SVAR(OCL_PCH_20_PATH, OCL_PCH_OBJECT_20);
   SVAR(OCL_HEADER_FILE_DIR, OCL_HEADER_DIR);
   BVAR(OCL_OUTPUT_KERNEL_SOURCE, false);
+  BVAR(OCL_PCH_CACHE, true);
+
+  /* Create every missing directory of path */
+  static bool makeDirs(const std::string &path)
+  {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      std::string dir = path.substr(0, pos);
+      if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+      if (pos == std::string::npos)
+        return true;
+    }
+  }
+
+  /* Build the PCH of ocl.h with the options which change its predefined macros */
+  static bool buildPCH(const std::vector<std::string> &pchOpt, const std::string &headerFile,
+                       const std::string &output)
+  {
+    vector<const char *> args;
+    for (auto &s : pchOpt)
+      args.push_back(s.c_str());
+    args.push_back("-emit-pch");
+    args.push_back("-x");
+    args.push_back("cl");
+    args.push_back("-o");
+    args.push_back(output.c_str());
+    args.push_back(headerFile.c_str());
+
+    std::string ErrorString;
+    llvm::raw_string_ostream ErrorInfo(ErrorString);
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts = new clang::DiagnosticOptions();
+    clang::TextDiagnosticPrinter *DiagClient =
+                             new clang::TextDiagnosticPrinter(ErrorInfo, &*DiagOpts);
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> DiagID(new clang::DiagnosticIDs());
+    clang::DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagClient);
+
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    auto CI = std::make_shared<clang::CompilerInvocation>();
+#else
+    std::unique_ptr<clang::CompilerInvocation> CI(new clang::CompilerInvocation);
+#endif
+    clang::CompilerInvocation::CreateFromArgs(*CI,
+                                              &args[0],
+                                              &args[0] + args.size(),
+                                              Diags);
+    clang::CompilerInstance Clang;
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    Clang.setInvocation(std::move(CI));
+#else
+    Clang.setInvocation(CI.release());
+#endif
+    Clang.createDiagnostics(DiagClient, false);
+    if (!Clang.hasDiagnostics())
+      return false;
+
+    clang::GeneratePCHAction Act;
+    bool ret = Clang.ExecuteAction(Act) && !Clang.getDiagnostics().hasErrorOccurred();
+    if (!ret && OCL_OUTPUT_BUILD_LOG)
+      llvm::errs() << ErrorString;
+    return ret;
+  }
+
+  /* The PCH shipped with the library is built with the default options. The
+     variants for other options are built on first use, in
+     $XDG_CACHE_HOME/beignet/pch (~/.cache/beignet/pch by default), and named
+     after everything they depend on. Returns an empty string if there is none. */
+  static std::string getPCHVariant(const std::vector<std::string> &pchOpt,
+                                   const std::string &headerDir,
+                                   const std::string &defaultPCH)
+  {
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    std::string headerFile = headerDir + "/ocl.h";
+    std::string cacheDir, key;
+    struct stat headerStat, pchStat;
+
+    if (!OCL_PCH_CACHE)
+      return "";
+    if (cacheHome != NULL && cacheHome[0] != '\0')
+      cacheDir = std::string(cacheHome) + "/beignet/pch";
+    else if (home != NULL && home[0] != '\0')
+      cacheDir = std::string(home) + "/.cache/beignet/pch";
+    else
+      return "";
+    if (stat(headerFile.c_str(), &headerStat) != 0 || stat(defaultPCH.c_str(), &pchStat) != 0)
+      return "";
+
+    std::ostringstream keyStream;
+    keyStream << clang::getClangFullVersion() << ' ' << headerFile << ' '
+              << headerStat.st_mtime << ' ' << pchStat.st_mtime;
+    for (auto &s : pchOpt)
+      keyStream << ' ' << s;
+    key = keyStream.str();
+
+    uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a
+    for (char c : key)
+      hash = (hash ^ (unsigned char)c) * 0x100000001b3ull;
+    char name[32];
+    snprintf(name, sizeof(name), "/ocl-%016llx.pch", (unsigned long long)hash);
+    std::string pchFile = cacheDir + name;
+    if (access(pchFile.c_str(), R_OK) == 0)
+      return pchFile;
+
+    /* Do not retry for every build a variant which failed */
+    static std::mutex failedLock;
+    static std::set<std::string> failed;
+    {
+      std::lock_guard<std::mutex> guard(failedLock);
+      if (failed.count(pchFile))
+        return "";
+    }
+
+    /* Concurrent builds, in this process or others, may create it too: each
+       writes its own file and renames it in place */
+    static std::atomic<uint32_t> tmpCount(0);
+    std::ostringstream tmpStream;
+    tmpStream << pchFile << '.' << getpid() << '.' << tmpCount++;
+    std::string tmpFile = tmpStream.str();
+    if (!makeDirs(cacheDir) || !buildPCH(pchOpt, headerFile, tmpFile) ||
+        rename(tmpFile.c_str(), pchFile.c_str()) != 0) {
+      unlink(tmpFile.c_str());
+      std::lock_guard<std::mutex> guard(failedLock);
+      failed.insert(pchFile);
+      return "";
+    }
+    return pchFile;
+  }
 
   static bool processSourceAndOption(const char *source,
                                      const char *options,
@@ -831,6 +1217,9 @@ namespace gbe {
 #else
     bool invalidPCH = false;
 #endif
+    /* The options which the PCH depends on */
+    std::vector<std::string> pchOpt;
+    bool pchOptChanged = false;
     size_t start = 0, end = 0;
 
     std::string hdirs = OCL_HEADER_FILE_DIR;
@@ -960,14 +1349,20 @@ EXTEND_QUOTE:
               *errSize = snprintf(err, stringSize, "Invalid build option: %s\n", str.c_str());
             return false;
           }
+          pchOpt.push_back(clOpt.back());
         }
 
-        if (uncompatiblePCHOptions.find(str) != std::string::npos)
+        if (uncompatiblePCHOptions.find(str) != std::string::npos) {
           invalidPCH = true;
+          pchOptChanged = true;
+        }
+        if (uncompatiblePCHOptions.find(str) != std::string::npos || str.find("-cl-std=") != std::string::npos)
+          pchOpt.push_back(str);
 
         if (fastMathOption.find(str) != std::string::npos) {
           clOpt.push_back("-D");
           clOpt.push_back("__FAST_RELAXED_MATH__=1");
+          pchOpt.push_back("-D__FAST_RELAXED_MATH__=1");
         }
 
         if(str.find("-dump-opt-llvm=") != std::string::npos) {
@@ -999,6 +1394,8 @@ EXTEND_QUOTE:
     if (useDefaultCLCVersion) {
       clOpt.push_back("-D__OPENCL_C_VERSION__=120");
       clOpt.push_back("-cl-std=CL1.2");
+      pchOpt.push_back("-D__OPENCL_C_VERSION__=120");
+      pchOpt.push_back("-cl-std=CL1.2");
       oclVersion = 120;
     }
     //for clCompilerProgram usage.
@@ -1022,6 +1419,24 @@ EXTEND_QUOTE:
       }
     }
 
+#if !defined(__ANDROID__)
+    if (findPCH && pchOptChanged) {
+      /* The flags ocl.h is built with by libocl */
+      pchOpt.insert(pchOpt.begin(), {"-fno-builtin", "-triple", oclVersion >= 200 ? "spir64" : "spir",
+                                     "-cl-kernel-arg-info", includePath});
+      if (oclVersion >= 200)
+        pchOpt.push_back("-fblocks");
+#ifdef GEN7_SAMPLER_CLAMP_BORDER_WORKAROUND
+      pchOpt.push_back("-DGEN7_SAMPLER_CLAMP_BORDER_WORKAROUND");
+#endif
+      std::string pchVariant = getPCHVariant(pchOpt, headerFilePath, pchFileName);
+      if (!pchVariant.empty()) {
+        pchFileName = pchVariant;
+        invalidPCH = false;
+      }
+    }
+#endif
+
     if (!findPCH || invalidPCH) {
       clOpt.push_back("-include");
       clOpt.push_back("ocl.h");
@@ -1061,9 +1476,7 @@ EXTEND_QUOTE:
     // will delete the module and act in GenProgram::CleanLlvmResource().
     llvm::Module * out_module;
     llvm::LLVMContext* llvm_ctx = new llvm::LLVMContext;
-    static std::mutex llvm_mutex;
-    if (!llvm::llvm_is_multithreaded())
-      llvm_mutex.lock();
+    acquireLLVMContextLock();
 
     if (buildModuleFromSource(source, &out_module, llvm_ctx, dumpLLVMFileName, dumpSPIRBinaryName, clOpt,
                               stringSize, err, errSize, oclVersion)) {
@@ -1094,8 +1507,7 @@ EXTEND_QUOTE:
     } else
       p = NULL;
 
-    if (!llvm::llvm_is_multithreaded())
-      llvm_mutex.unlock();
+    releaseLLVMContextLock();
 
     return p;
   }
@@ -1293,16 +1705,34 @@ EXTEND_QUOTE:
 
   static gbe_kernel programGetKernelByName(gbe_program gbeProgram, const char *name) {
     if (gbeProgram == NULL) return NULL;
-    const gbe::Program *program = (gbe::Program*) gbeProgram;
+    gbe::Program *program = (gbe::Program*) gbeProgram;
     return (gbe_kernel) program->getKernel(std::string(name));
   }
 
   static gbe_kernel programGetKernel(const gbe_program gbeProgram, uint32_t ID) {
     if (gbeProgram == NULL) return NULL;
-    const gbe::Program *program = (gbe::Program*) gbeProgram;
+    gbe::Program *program = (gbe::Program*) gbeProgram;
     return (gbe_kernel) program->getKernel(ID);
   }
 
+  static const char *programGetKernelName(gbe_program gbeProgram, uint32_t ID) {
+    if (gbeProgram == NULL) return NULL;
+    const gbe::Program *program = (const gbe::Program*) gbeProgram;
+    return program->getKernelName(ID);
+  }
+
+  static size_t programTakeLazyLog(gbe_program gbeProgram, char *log, size_t size) {
+    if (gbeProgram == NULL) return 0;
+    gbe::Program *program = (gbe::Program*) gbeProgram;
+    return program->takeLazyLog(log, size);
+  }
+
+  static uint32_t programGetOclVersion(gbe_program gbeProgram) {
+    if (gbeProgram == NULL) return 0;
+    const gbe::Program *program = (const gbe::Program*) gbeProgram;
+    return program->getOclVersion();
+  }
+
   static const char *kernelGetName(gbe_kernel genKernel) {
     if (genKernel == NULL) return NULL;
     const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
@@ -1399,6 +1829,12 @@ EXTEND_QUOTE:
     return kernel->getCurbeSize();
   }
 
+  static int32_t kernelGetCrossThreadCurbeSize(gbe_kernel genKernel) {
+    if (genKernel == NULL) return 0;
+    const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
+    return kernel->getCrossThreadCurbeSize();
+  }
+
   static int32_t kernelGetStackSize(gbe_kernel genKernel) {
     if (genKernel == NULL) return 0;
     const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
@@ -1516,15 +1952,30 @@ EXTEND_QUOTE:
   }
 } /* namespace gbe */
 
+/* Before LLVM 3.9 all the modules live in the global LLVM context. Since
+   then every build owns its context, so builds only have to run one at a
+   time when LLVM itself is not thread safe. */
+static bool llvmContextNeedsLock(void)
+{
+#if defined(GBE_COMPILER_AVAILABLE) && LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 39
+  static const bool needsLock = !llvm::llvm_is_multithreaded();
+  return needsLock;
+#else
+  return true;
+#endif
+}
+
 std::mutex llvm_ctx_mutex;
 void acquireLLVMContextLock()
 {
-  llvm_ctx_mutex.lock();
+  if (llvmContextNeedsLock())
+    llvm_ctx_mutex.lock();
 }
 
 void releaseLLVMContextLock()
 {
-  llvm_ctx_mutex.unlock();
+  if (llvmContextNeedsLock())
+    llvm_ctx_mutex.unlock();
 }
 
 GBE_EXPORT_SYMBOL gbe_program_new_from_source_cb *gbe_program_new_from_source = NULL;
@@ -1548,6 +1999,9 @@ GBE_EXPORT_SYMBOL gbe_program_delete_cb *gbe_program_delete = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_num_cb *gbe_program_get_kernel_num = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_by_name_cb *gbe_program_get_kernel_by_name = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_cb *gbe_program_get_kernel = NULL;
+GBE_EXPORT_SYMBOL gbe_program_get_kernel_name_cb *gbe_program_get_kernel_name = NULL;
+GBE_EXPORT_SYMBOL gbe_program_take_lazy_log_cb *gbe_program_take_lazy_log = NULL;
+GBE_EXPORT_SYMBOL gbe_program_get_ocl_version_cb *gbe_program_get_ocl_version = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_device_enqueue_kernel_name_cb *gbe_program_get_device_enqueue_kernel_name = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_name_cb *gbe_kernel_get_name = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_attributes_cb *gbe_kernel_get_attributes = NULL;
@@ -1562,6 +2016,7 @@ GBE_EXPORT_SYMBOL gbe_kernel_get_arg_align_cb *gbe_kernel_get_arg_align = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_simd_width_cb *gbe_kernel_get_simd_width = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_curbe_offset_cb *gbe_kernel_get_curbe_offset = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_curbe_size_cb *gbe_kernel_get_curbe_size = NULL;
+GBE_EXPORT_SYMBOL gbe_kernel_get_cross_thread_curbe_size_cb *gbe_kernel_get_cross_thread_curbe_size = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_stack_size_cb *gbe_kernel_get_stack_size = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_scratch_size_cb *gbe_kernel_get_scratch_size = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_required_work_group_size_cb *gbe_kernel_get_required_work_group_size = NULL;
@@ -1605,6 +2060,9 @@ namespace gbe
       gbe_program_get_device_enqueue_kernel_name = gbe::programGetDeviceEnqueueKernelName;
       gbe_program_get_kernel_by_name = gbe::programGetKernelByName;
       gbe_program_get_kernel = gbe::programGetKernel;
+      gbe_program_get_kernel_name = gbe::programGetKernelName;
+      gbe_program_take_lazy_log = gbe::programTakeLazyLog;
+      gbe_program_get_ocl_version = gbe::programGetOclVersion;
       gbe_kernel_get_name = gbe::kernelGetName;
       gbe_kernel_get_attributes = gbe::kernelGetAttributes;
       gbe_kernel_get_code = gbe::kernelGetCode;
@@ -1618,6 +2076,7 @@ namespace gbe
       gbe_kernel_get_simd_width = gbe::kernelGetSIMDWidth;
       gbe_kernel_get_curbe_offset = gbe::kernelGetCurbeOffset;
       gbe_kernel_get_curbe_size = gbe::kernelGetCurbeSize;
+      gbe_kernel_get_cross_thread_curbe_size = gbe::kernelGetCrossThreadCurbeSize;
       gbe_kernel_get_stack_size = gbe::kernelGetStackSize;
       gbe_kernel_get_scratch_size = gbe::kernelGetScratchSize;
       gbe_kernel_get_required_work_group_size = gbe::kernelGetRequiredWorkGroupSize;
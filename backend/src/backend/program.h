@@ -70,6 +70,9 @@ enum gbe_get_arg_info_value {
   GBE_GET_ARG_INFO_INVALID = 0xffffffff
 };
 
+/*! Version of the Gen binary format, first byte of the binary header */
+#define GBE_GEN_BINARY_VERSION 2
+
 // BTI magic number
 #define BTI_CONSTANT 0
 #define BTI_PRIVATE 1
@@ -310,6 +313,19 @@ extern gbe_program_get_kernel_by_name_cb *gbe_program_get_kernel_by_name;
 typedef gbe_kernel (gbe_program_get_kernel_cb)(gbe_program, uint32_t ID);
 extern gbe_program_get_kernel_cb *gbe_program_get_kernel;
 
+/*! Get the kernel name from its ID, without generating the kernel code */
+typedef const char *(gbe_program_get_kernel_name_cb)(gbe_program, uint32_t ID);
+extern gbe_program_get_kernel_name_cb *gbe_program_get_kernel_name;
+
+/*! Move the build log of the kernels generated on demand into log, at most
+ *  size bytes including the terminating zero. Returns the log length */
+typedef size_t (gbe_program_take_lazy_log_cb)(gbe_program, char *log, size_t size);
+extern gbe_program_take_lazy_log_cb *gbe_program_take_lazy_log;
+
+/*! Get the OpenCL version the program was built for */
+typedef uint32_t (gbe_program_get_ocl_version_cb)(gbe_program);
+extern gbe_program_get_ocl_version_cb *gbe_program_get_ocl_version;
+
 typedef const char* (gbe_program_get_device_enqueue_kernel_name_cb)(gbe_program, uint32_t ID);
 extern gbe_program_get_device_enqueue_kernel_name_cb *gbe_program_get_device_enqueue_kernel_name;
 
@@ -361,6 +377,12 @@ extern gbe_kernel_get_simd_width_cb *gbe_kernel_get_simd_width;
 typedef int32_t (gbe_kernel_get_curbe_size_cb)(gbe_kernel);
 extern gbe_kernel_get_curbe_size_cb *gbe_kernel_get_curbe_size;
 
+/*! Get the size of the curbe head read once for all the threads (0 if the
+ *  whole curbe is per thread)
+ */
+typedef int32_t (gbe_kernel_get_cross_thread_curbe_size_cb)(gbe_kernel);
+extern gbe_kernel_get_cross_thread_curbe_size_cb *gbe_kernel_get_cross_thread_curbe_size;
+
 /*! Get the stack size (zero if no stack is required) */
 typedef int32_t (gbe_kernel_get_stack_size_cb)(gbe_kernel);
 extern gbe_kernel_get_stack_size_cb *gbe_kernel_get_stack_size;
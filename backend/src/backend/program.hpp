@@ -34,6 +34,7 @@
 #include "ir/sampler.hpp"
 #include "sys/vector.hpp"
 #include <string>
+#include <mutex>
 
 namespace gbe {
 namespace ir {
@@ -90,6 +91,8 @@ namespace gbe {
     virtual const char *getCode(void) const = 0;
     /*! Set the instruction stream.*/
     virtual void setCode(const char *, size_t size) = 0;
+    /*! Use an instruction stream owned by someone else, without copying it */
+    virtual void setCodeInPlace(const char *, size_t size) = 0;
     /*! Return the instruction stream size (to be implemented) */
     virtual uint32_t getCodeSize(void) const = 0;
     /*! Get the kernel name */
@@ -116,6 +119,8 @@ namespace gbe {
     int32_t getCurbeOffset(gbe_curbe_type type, uint32_t subType) const;
     /*! Get the curbe size required by the kernel */
     INLINE uint32_t getCurbeSize(void) const { return this->curbeSize; }
+    /*! Get the size of the curbe head shared by all the threads (0 if none) */
+    INLINE uint32_t getCrossThreadCurbeSize(void) const { return this->crossThreadCurbeSize; }
     /*! Return the size of the stack (zero if none) */
     INLINE uint32_t getStackSize(void) const { return this->stackSize; }
     /*! Return the size of the scratch memory needed (zero if none) */
@@ -216,6 +221,7 @@ namespace gbe {
        PatchInfo_num     |
        PatchInfo         |
        curbeSize         |
+       crossThreadCurbeSize |
        simdWidth         |
        stackSize         |
        scratchSize       |
@@ -231,6 +237,9 @@ namespace gbe {
     /*! Implements the serialization. */
     virtual uint32_t serializeToBin(std::ostream& outs);
     virtual uint32_t deserializeFromBin(std::istream& ins);
+    /*! Deserialize from memory, the code is used in place and the image must
+     *  outlive the kernel */
+    uint32_t deserializeFromImage(const char *image, uint32_t size);
     virtual void printStatus(int indent, std::ostream& outs);
     /*! Does kernel use device enqueue */
     INLINE bool getUseDeviceEnqueue(void) const { return this->useDeviceEnqueue; }
@@ -240,6 +249,9 @@ namespace gbe {
     }
 
   protected:
+    /*! Deserialize from the stream, image is where the stream starts when it
+     *  reads from memory, or NULL */
+    uint32_t deserialize(std::istream& ins, const char *image);
     friend class Context;      //!< Owns the kernels
     friend class GenContext;
     std::string name;    //!< Kernel name
@@ -247,6 +259,7 @@ namespace gbe {
     vector<PatchInfo> patches; //!< Indicates how to build the curbe
     uint32_t argNum;           //!< Number of function arguments
     uint32_t curbeSize;        //!< Size of the data to push
+    uint32_t crossThreadCurbeSize; //!< Head of the curbe shared by all the threads
     uint32_t simdWidth;        //!< SIMD size for the kernel (lane number)
     uint32_t stackSize;        //!< Stack size (0 if unused)
     uint32_t scratchSize;      //!< Scratch memory size (may be 0 if unused)
@@ -276,27 +289,38 @@ namespace gbe {
     virtual void CleanLlvmResource() = 0;
     /*! Get the number of kernels in the program */
     uint32_t getKernelNum(void) const { return kernels.size(); }
-    /*! Get the kernel from its name */
-    Kernel *getKernel(const std::string &name) const {
+    /*! Get the kernel from its name, generating its code if it was deferred */
+    Kernel *getKernel(const std::string &name) {
       map<std::string, Kernel*>::const_iterator it = kernels.find(name);
       if (it == kernels.end())
         return NULL;
+      else if (this->isLazy())
+        return this->buildLazyKernel(name);
       else
         return it->second;
     }
-    /*! Get the kernel from its ID */
-    Kernel *getKernel(uint32_t ID) const {
+    /*! Get the kernel from its ID, generating its code if it was deferred */
+    Kernel *getKernel(uint32_t ID) {
+      const char *name = this->getKernelName(ID);
+      if (name == NULL)
+        return NULL;
+      return this->getKernel(std::string(name));
+    }
+    /*! Move the build log of the deferred kernels into log, at most size
+     *  bytes including the terminating zero. Returns the log length */
+    size_t takeLazyLog(char *log, size_t size);
+    /*! Get the kernel name from its ID without generating its code */
+    const char *getKernelName(uint32_t ID) const {
       uint32_t currID = 0;
-      Kernel *kernel = NULL;
       for (map<std::string, Kernel*>::const_iterator it = kernels.begin(); it != kernels.end(); ++it) {
-        if (currID == ID) {
-          kernel = it->second;
-          break;
-        }
+        if (currID == ID)
+          return it->first.c_str();
         currID++;
       }
-      return kernel;
+      return NULL;
     }
+    /*! Get the OpenCL version the program was built for */
+    uint32_t getOclVersion(void) const { return oclVersion; }
 
     const char *getDeviceEnqueueKernelName(uint32_t index) const {
       if(index >= blockFuncs.size())
@@ -304,7 +328,7 @@ namespace gbe {
       return blockFuncs[index].c_str();
     }
     /*! Build a program from a ir::Unit */
-    bool buildFromUnit(const ir::Unit &unit, std::string &error);
+    bool buildFromUnit(const ir::Unit &unit, std::string &error, bool deferCodegen = false);
     /*! Buils a program from a LLVM Module */
     bool buildFromLLVMModule(const void* module, std::string &error, int optLevel);
     /*! Buils a program from a OCL string */
@@ -321,9 +345,13 @@ namespace gbe {
 
     /* format:
        magic_begin       |
+       oclVersion        |
        constantSet_flag  |
        constSet_data     |
+       relocTable_flag   |
+       relocTable_data   |
        kernel_num        |
+       kernel_table      |  name_size, name and serialized size of each kernel
        kernel_1          |
        ........          |
        kernel_n          |
@@ -334,6 +362,9 @@ namespace gbe {
     /*! Implements the serialization. */
     virtual uint32_t serializeToBin(std::ostream& outs);
     virtual uint32_t deserializeFromBin(std::istream& ins);
+    /*! Deserialize from memory. Only the header and the kernel table are
+     *  read, the kernels are deserialized the first time they are requested */
+    bool deserializeFromImage(const char *image, size_t size);
     virtual void printStatus(int indent, std::ostream& outs);
     uint32_t fast_relaxed_math : 1;
 
@@ -343,8 +374,41 @@ namespace gbe {
                                   bool relaxMath, int profiling) = 0;
     /*! Allocate an empty kernel. */
     virtual Kernel *allocateKernel(const std::string &name) = 0;
-    /*! Kernels sorted by their name */
+    /*! Whether code generation may be deferred until a kernel is requested */
+    virtual bool canDeferCodegen(void) const { return true; }
+    /*! Generate, or look up, the code of a deferred kernel */
+    virtual Kernel *buildLazyKernel(const std::string &name);
+    /*! Compile one kernel of the unit and attach its unit level info */
+    Kernel *buildKernel(const ir::Unit &unit, const std::string &name, std::string &error);
+    /*! Take the constants, relocations and device enqueue info of the unit */
+    void setUnitGlobals(const ir::Unit &unit);
+    /*! Build the module again without the forced loop unrolling, and keep
+     *  those kernels if they get more of them compiled in SIMD16 */
+    bool buildWithoutForcedUnroll(const void* module, int optLevel, bool strictMath,
+                                  bool built, std::string &error);
+    /*! Kernels sorted by their name, NULL until generated in lazy mode */
     map<std::string, Kernel*> kernels;
+    /*! Unit kept alive to generate the kernels on demand in lazy mode */
+    ir::Unit *lazyUnit;
+    /*! Binary the kernels are deserialized from on demand */
+    char *image;
+    /*! Offset and size of each kernel in the image */
+    map<std::string, std::pair<uint32_t, uint32_t>> imageKernels;
+    /*! Serializes the generation of deferred kernels */
+    std::mutex lazyMutex;
+    /*! Build log of the deferred kernels, until the runtime takes it */
+    std::string lazyLog;
+    /*! Deferred kernels whose code generation failed, not tried again */
+    set<std::string> lazyFailed;
+    /*! Opencl Version (120 for 1.2, 200 for 2.0) */
+    uint32_t oclVersion;
+    /*! Kernels compileKernel failed to allocate in SIMD16 */
+    set<std::string> simd16Failed;
+    /*! Read everything before the kernels */
+    uint32_t deserializeHeader(std::istream& ins,
+                               vector<std::pair<std::string, uint32_t>> &kernelTable);
+    /*! Whether some kernels are only generated on demand */
+    bool isLazy(void) const { return lazyUnit != NULL || image != NULL; }
     /*! Global (constants) outside any kernel */
     ir::ConstantSet *constantSet;
     /*! relocation table */
@@ -197,7 +197,7 @@ void program_build_instance::serialize_program(void) throw(int)
       if(gen_pci_id){
         //add header to differeciate from llvm bitcode binary.
         // (5 bytes: 1 byte for binary version, 4 byte for bc code, 'GENC' is for gen binary.)
-        char gen_header[6] = "\1GENC";
+        const char gen_header[5] = {GBE_GEN_BINARY_VERSION, 'G', 'E', 'N', 'C'};
         OUTS_UPDATE_SZ(gen_header[0]);
         OUTS_UPDATE_SZ(gen_header[1]);
         OUTS_UPDATE_SZ(gen_header[2]);
@@ -244,7 +244,7 @@ void program_build_instance::serialize_program(void) throw(int)
       if(gen_pci_id){
         //add header to differeciate from llvm bitcode binary.
         // (5 bytes: 1 byte for binary version, 4 byte for bc code, 'GENC' is for gen binary.)
-        char gen_header[6] = "\1GENC";
+        const char gen_header[5] = {GBE_GEN_BINARY_VERSION, 'G', 'E', 'N', 'C'};
         OUTF_UPDATE_SZ(gen_header[0]);
         OUTF_UPDATE_SZ(gen_header[1]);
         OUTF_UPDATE_SZ(gen_header[2]);
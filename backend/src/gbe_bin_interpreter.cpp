@@ -40,11 +40,15 @@ struct BinInterpCallBackInitializer
     gbe_program_get_kernel_num = gbe::programGetKernelNum;
     gbe_program_get_kernel_by_name = gbe::programGetKernelByName;
     gbe_program_get_kernel = gbe::programGetKernel;
+    gbe_program_get_kernel_name = gbe::programGetKernelName;
+    gbe_program_take_lazy_log = gbe::programTakeLazyLog;
+    gbe_program_get_ocl_version = gbe::programGetOclVersion;
     gbe_program_get_device_enqueue_kernel_name = gbe::programGetDeviceEnqueueKernelName;
     gbe_kernel_get_code_size = gbe::kernelGetCodeSize;
     gbe_kernel_get_code = gbe::kernelGetCode;
     gbe_kernel_get_arg_num = gbe::kernelGetArgNum;
     gbe_kernel_get_curbe_size = gbe::kernelGetCurbeSize;
+    gbe_kernel_get_cross_thread_curbe_size = gbe::kernelGetCrossThreadCurbeSize;
     gbe_kernel_get_sampler_size = gbe::kernelGetSamplerSize;
     gbe_kernel_get_compile_wg_size = gbe::kernelGetCompileWorkGroupSize;
     gbe_kernel_get_stack_size = gbe::kernelGetStackSize;
@@ -395,7 +395,7 @@ namespace ir {
                                          isStructureExit(false), isLoopExit(false),
                                          hasExtraBra(false),
                                          matchingStructureEntry(NULL),
-                                         fn(fn) {
+                                         breakLabel(0), fn(fn) {
     this->nextBlock = this->prevBlock = NULL;
   }
 
@@ -149,6 +149,9 @@ namespace ir {
     /* selfLoop's label.
      * */
     LabelIndex whileLabel;
+    /* set on the exit bb of a selfLoop which contains BREAKs, it is the label
+     * put just before the WHILE and used as the JIP and UIP of the BREAKs. */
+    LabelIndex breakLabel;
   private:
     friend class Function; //!< Owns the basic blocks
     BlockSet predecessors; //!< Incoming blocks
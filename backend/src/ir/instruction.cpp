@@ -424,7 +424,7 @@ namespace ir {
     {
     public:
       INLINE BranchInstruction(Opcode op, LabelIndex labelIndex, Register predicate, bool inv_pred=false) {
-        GBE_ASSERT(op == OP_BRA || op == OP_IF || op == OP_WHILE);
+        GBE_ASSERT(op == OP_BRA || op == OP_IF || op == OP_WHILE || op == OP_BREAK);
         this->opcode = op;
         this->predicate = predicate;
         this->labelIndex = labelIndex;
@@ -1904,7 +1904,7 @@ namespace ir {
 
     INLINE void BranchInstruction::out(std::ostream &out, const Function &fn) const {
       this->outOpcode(out);
-      if(opcode == OP_IF && inversePredicate)
+      if((opcode == OP_IF || opcode == OP_BREAK) && inversePredicate)
         out << " !";
       if (hasPredicate)
         out << "<%" << this->getSrc(fn, 0) << ">";
@@ -2685,6 +2685,11 @@ DECL_MEM_FN(MemInstruction, void,     setBtiReg(Register reg), setBtiReg(reg))
     return internal::BranchInstruction(OP_WHILE, labelIndex, pred).convert();
   }
 
+  // BREAK
+  Instruction BREAK(LabelIndex labelIndex, Register pred, bool inv_pred) {
+    return internal::BranchInstruction(OP_BREAK, labelIndex, pred, inv_pred).convert();
+  }
+
   // RET
   Instruction RET(void) {
     return internal::BranchInstruction(OP_RET).convert();
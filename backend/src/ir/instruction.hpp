@@ -869,6 +869,8 @@ namespace ir {
   Instruction ENDIF(LabelIndex labelIndex);
   /*! (pred) while labelIndex */
   Instruction WHILE(LabelIndex labelIndex, Register pred);
+  /*! (pred) break labelIndex */
+  Instruction BREAK(LabelIndex labelIndex, Register pred, bool inv_pred=false);
   /*! ret */
   Instruction RET(void);
   /*! load.type.space {dst1,...,dst_valueNum} offset value, {bti} */
@@ -60,6 +60,60 @@ namespace ir {
     it->remove();
   }
 
+  /* return the conditional BRA at the bottom of bb, it may be followed by an
+   * unconditional BRA. */
+  static BranchInstruction *getConditionalBranch(BasicBlock *bb)
+  {
+    BasicBlock::iterator it = bb->end();
+    for(int i = 0; i < 2 && it != bb->begin(); i++)
+    {
+      --it;
+      if((*it).getOpcode() != OP_BRA)
+        return NULL;
+      BranchInstruction *pinsn = static_cast<BranchInstruction *>(&*it);
+      if(pinsn->isPredicated())
+        return pinsn;
+    }
+    return NULL;
+  }
+
+  /* replace the early exits of a matched loop with BREAKs. the BREAKs are at the top
+   * level of the loop body, so both their JIP and UIP are the WHILE of the latch. */
+  void CFGStructurizer::handleBreakBlocks(Block *loopblock)
+  {
+    BreakLoop *loop = NULL;
+    for(auto &l : breakLoops)
+      if(l.loop == loopblock)
+        loop = &l;
+    if(loop == NULL)
+      return;
+
+    LabelIndex breakLabel = fn->newLabel();
+    loop->latch->breakLabel = breakLabel;
+    for(auto &br : loop->breaks)
+    {
+      BasicBlock *pbb = br.first;
+      BranchInstruction *pinsn = getConditionalBranch(pbb);
+      GBE_ASSERT(pinsn != NULL);
+      Register reg = pinsn->getPredicateIndex();
+      // the lanes leave the loop when the BRA is taken or, if the BRA stays in
+      // the loop, when it is not taken.
+      bool inversePredicate = pinsn->getLabelIndex() != loop->exit->getLabelIndex();
+      while(pbb->getLastInstruction()->getOpcode() == OP_BRA)
+        pbb->getLastInstruction()->remove();
+
+      Instruction insn = BREAK(breakLabel, reg, inversePredicate);
+      Instruction* p_new_insn = pbb->getParent().newInstruction(insn);
+      pbb->append(*p_new_insn);
+      if(pbb->getNextBlock() != br.second)
+      {
+        Instruction bra = BRA(br.second->getLabelIndex());
+        p_new_insn = pbb->getParent().newInstruction(bra);
+        pbb->append(*p_new_insn);
+      }
+    }
+  }
+
   /* recursive mark the bbs' variable needEndif*/
   void CFGStructurizer::markNeedIf(Block *block, bool status)
   {
@@ -373,6 +427,7 @@ namespace ir {
             {
               LabelIndex whilelabel;
               handleSelfLoopBlock(*it, whilelabel);
+              handleBreakBlocks(*it);
             }
             break;
 
@@ -539,6 +594,16 @@ namespace ir {
       }
       iter++;
     }
+
+    /* the lanes which break out of a loop wait for the others at the WHILE, so the
+     * livein of the loop exit must not be destroyed by the rest of the loop body. */
+    for(auto &loop : breakLoops)
+    {
+      std::set<Register> livein;
+      getLiveIn(*loop.exit, livein);
+      for(auto bb : loop.bbs)
+        bb->liveout.insert(livein.begin(), livein.end());
+    }
   }
 
   void CFGStructurizer::initializeBlocks()
@@ -614,6 +679,141 @@ namespace ir {
         });
   }
 
+  /* find the loops which have a single latch and whose other exits all go to the bb
+   * the latch falls through to. such an early exit can be a BREAK, so its edge is
+   * removed from the block CFG to let the loop body reduce to a selfLoop. */
+  void CFGStructurizer::findBreakLoops()
+  {
+    for(auto l : loops)
+    {
+      if(l->exits.size() < 2)
+        continue;
+
+      BreakLoop loop;
+      loop.header = &fn->getBlock(l->bbs[0]);
+      loop.exit = &fn->getBlock(l->exits[0].second);
+      loop.latch = NULL;
+      loop.loop = NULL;
+      for(auto bb : l->bbs)
+        loop.bbs.insert(&fn->getBlock(bb));
+
+      bool valid = true;
+      for(auto &e : l->exits)
+        if(&fn->getBlock(e.second) != loop.exit)
+          valid = false;
+      for(auto bb : loop.bbs)
+      {
+        if(bb->getSuccessorSet().find(loop.header) == bb->getSuccessorSet().end())
+          continue;
+        if(loop.latch != NULL)
+          valid = false;
+        loop.latch = bb;
+      }
+      if(!valid || loop.latch == NULL)
+        continue;
+
+      // the latch becomes the WHILE, so it must end with the conditional backward BRA.
+      Instruction *last = loop.latch->getLastInstruction();
+      if(last->getOpcode() != OP_BRA ||
+         !static_cast<BranchInstruction *>(last)->isPredicated() ||
+         static_cast<BranchInstruction *>(last)->getLabelIndex() != loop.header->getLabelIndex() ||
+         loop.latch->getSuccessorSet().find(loop.exit) == loop.latch->getSuccessorSet().end())
+        continue;
+
+      for(auto &e : l->exits)
+      {
+        BasicBlock *pbb = &fn->getBlock(e.first);
+        if(pbb == loop.latch)
+          continue;
+        // a BREAK only leaves its innermost loop.
+        for(auto l2 : loops)
+          if(l2 != l && l2->bbs.size() < l->bbs.size() &&
+             std::find(l2->bbs.begin(), l2->bbs.end(), e.first) != l2->bbs.end())
+            valid = false;
+        if(pbb->getSuccessorSet().size() != 2 || checkForBarrier(pbb) ||
+           getConditionalBranch(pbb) == NULL)
+          valid = false;
+        if(!valid)
+          break;
+
+        BasicBlock *succ = NULL;
+        for(auto s : pbb->getSuccessorSet())
+          if(s != loop.exit)
+            succ = s;
+        GBE_ASSERT(loop.bbs.find(succ) != loop.bbs.end());
+        loop.breaks[pbb] = succ;
+      }
+      if(!valid || loop.breaks.empty())
+        continue;
+
+      for(auto &br : loop.breaks)
+      {
+        Block *block = bbmap[br.first];
+        Block *exitBlock = bbmap[loop.exit];
+        block->successors().erase(exitBlock);
+        exitBlock->predecessors().erase(block);
+      }
+      breakLoops.push_back(loop);
+    }
+  }
+
+  /* whether the block contains an early exit of a loop which is not matched yet. */
+  bool CFGStructurizer::hasPendingBreak(Block *block)
+  {
+    if(breakLoops.empty())
+      return false;
+
+    std::set<BasicBlock *> bbs = getStructureBasicBlocks(block);
+    for(auto &loop : breakLoops)
+    {
+      if(loop.loop != NULL)
+        continue;
+      for(auto &br : loop.breaks)
+        if(bbs.find(br.first) != bbs.end())
+          return true;
+    }
+    return false;
+  }
+
+  void CFGStructurizer::claimBreakLoop(Block *loopBlock)
+  {
+    if(breakLoops.empty())
+      return;
+
+    std::set<BasicBlock *> bbs = getStructureBasicBlocks(loopBlock);
+    for(auto &loop : breakLoops)
+      if(loop.loop == NULL && loop.bbs == bbs)
+        loop.loop = loopBlock;
+  }
+
+  /* a loop whose early exits were hidden but which was not matched keeps its BRAs,
+   * so the structures built on the hidden edges must not be handled. */
+  void CFGStructurizer::dropUnmatchedBreakLoops()
+  {
+    auto loop = breakLoops.begin();
+    while(loop != breakLoops.end())
+    {
+      if(loop->loop != NULL)
+      {
+        loop++;
+        continue;
+      }
+      for(auto block : blocks)
+      {
+        if(block->type() == SingleBlockType)
+          continue;
+        std::set<BasicBlock *> bbs = getStructureBasicBlocks(block);
+        bool broken = bbs.find(loop->exit) != bbs.end() && block->getEntry() != loop->exit;
+        for(auto &br : loop->breaks)
+          if(bbs.find(br.first) != bbs.end())
+            broken = true;
+        if(broken)
+          block->canBeHandled = false;
+      }
+      loop = breakLoops.erase(loop);
+    }
+  }
+
   void CFGStructurizer::outBlockTypes(BlockType type)
   {
     if(type == SerialBlockType)
@@ -835,6 +1035,7 @@ namespace ir {
     Block* mergedBB = mergeLoopBlock(loopBBs);
     if(mergedBB == NULL)
       return 0;
+    claimBreakLoop(mergedBB);
 
     cfgUpdate(mergedBB, loopSets);
     replace(mergedBB, loopSets);
@@ -895,7 +1096,8 @@ namespace ir {
         && TrueBB->pred_size() == 1 && FalseBB->pred_size() == 1
         && *TrueBB->succ_begin() == *FalseBB->succ_begin()
         && !TrueBB->hasBarrier() && !FalseBB->hasBarrier()
-        && TrueBB->insnNum < 1000 && FalseBB->insnNum < 1000) {
+        && TrueBB->insnNum < 1000 && FalseBB->insnNum < 1000
+        && !hasPendingBreak(TrueBB) && !hasPendingBreak(FalseBB)) {
       // if-else pattern
       ifSets.insert(block);
       if(block->fallthrough() == TrueBB) {
@@ -916,7 +1118,8 @@ namespace ir {
 
       insertBlock(mergedBB);
     } else if (TrueBB->succ_size() == 1 && TrueBB->pred_size() == 1 &&
-        *TrueBB->succ_begin() == FalseBB && !TrueBB->hasBarrier() && TrueBB->insnNum < 1000 ) {
+        *TrueBB->succ_begin() == FalseBB && !TrueBB->hasBarrier() && TrueBB->insnNum < 1000 &&
+        !hasPendingBreak(TrueBB)) {
       // if-then pattern, false is empty
       ifSets.insert(block);
       ifSets.insert(TrueBB);
@@ -930,7 +1133,8 @@ namespace ir {
 
       insertBlock(mergedBB);
     } else if (FalseBB->succ_size() == 1 && FalseBB->pred_size() == 1 &&
-        *FalseBB->succ_begin() == TrueBB && !FalseBB->hasBarrier() && FalseBB->insnNum < 1000 ) {
+        *FalseBB->succ_begin() == TrueBB && !FalseBB->hasBarrier() && FalseBB->insnNum < 1000 &&
+        !hasPendingBreak(FalseBB)) {
       // if-then pattern, true is empty
       ifSets.insert(block);
       ifSets.insert(FalseBB);
@@ -1005,7 +1209,9 @@ namespace ir {
   void CFGStructurizer::StructurizeBlocks()
   {
     initializeBlocks();
+    findBreakLoops();
     blockPatternMatch();
+    dropUnmatchedBreakLoops();
     handleStructuredBlocks();
     calculateNecessaryLiveout();
   }
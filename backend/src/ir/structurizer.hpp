@@ -189,6 +189,21 @@ namespace ir {
     }
   };
 
+  /* a loop with a single latch whose other exits all go to the latch's exit bb.
+   * the early exits are hidden from the pattern matching and turned into BREAKs
+   * once the loop is matched as a selfLoop. */
+  struct BreakLoop
+  {
+    BasicBlock *header;
+    BasicBlock *latch;
+    BasicBlock *exit;
+    std::set<BasicBlock *> bbs;
+    /* break bb -> its successor inside the loop. */
+    std::map<BasicBlock *, BasicBlock *> breaks;
+    /* the matched selfLoop block, NULL until the loop is matched. */
+    Block *loop;
+  };
+
   class CFGStructurizer{
     public:
       CFGStructurizer(Function* fn) { this->fn = fn; numSerialPatternMatch = 0; numLoopPatternMatch = 0; numIfPatternMatch = 0;}
@@ -213,6 +228,10 @@ namespace ir {
       int  ifPatternMatch(Block *block);
       int  patternMatch(Block *block);
       void collectInsnNum(Block* block, const BasicBlock* bb);
+      void findBreakLoops();
+      bool hasPendingBreak(Block *block);
+      void claimBreakLoop(Block *loopBlock);
+      void dropUnmatchedBreakLoops();
 
     private:
       void handleSelfLoopBlock(Block *loopblock, LabelIndex& whileLabel);
@@ -223,6 +242,7 @@ namespace ir {
       void handleThenBlock(Block * block, LabelIndex& endiflabel);
       void handleThenBlock2(Block *block, Block *elseblock, LabelIndex elseBBLabel);
       void handleElseBlock(Block * block, LabelIndex& elselabel, LabelIndex& endiflabel);
+      void handleBreakBlocks(Block *loopblock);
       void handleStructuredBlocks();
       void getStructureSequence(Block *block, std::vector<BasicBlock*> &seq);
       std::set<int> getStructureBasicBlocksIndex(Block* block, std::vector<BasicBlock *> &bbs);
@@ -240,6 +260,7 @@ namespace ir {
       BlockVector blocks;
       Block* blocks_entry;
       gbe::vector<Loop *> loops;
+      std::vector<BreakLoop> breakLoops;
       BlockList orderedBlks;
       BlockList::iterator orderIter;
   };
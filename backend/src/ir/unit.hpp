@@ -30,6 +30,7 @@
 #include "ir/printf.hpp"
 #include "ir/reloc.hpp"
 #include "sys/map.hpp"
+#include "sys/set.hpp"
 #include <string.h>
 
 namespace gbe {
@@ -90,6 +91,11 @@ namespace ir {
     bool getValid() { return valid; }
     void setOclVersion(uint32_t version) { oclVersion = version; }
     uint32_t getOclVersion() const { return oclVersion; }
+    /*! Record that some loops of the function were forced to be unrolled
+     *  beyond the LLVM heuristics */
+    void setForcedUnroll(const std::string &name) { forcedUnroll.insert(name); }
+    /*! Get whether some loops of the function were forced to be unrolled */
+    bool getForcedUnroll(const std::string &name) const { return forcedUnroll.contains(name); }
   private:
     friend class ContextInterface; //!< Can free modify the unit
     FunctionSet functions; //!< All the defined functions
@@ -101,6 +107,7 @@ namespace ir {
     uint32_t oclVersion;
     bool valid;
     bool inProfilingMode;
+    set<std::string> forcedUnroll; //!< Functions with forced loop unrolling
   };
 
   /*! Output the unit string in the given stream */
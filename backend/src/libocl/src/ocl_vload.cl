@@ -70,47 +70,50 @@ OVERLOADABLE TYPE##3 vload3(size_t offset, const SPACE TYPE *p) { \
   DECL_UNTYPED_RD_ALL_SPACE(TYPE, __constant) \
   DECL_UNTYPED_RW_ALL_SPACE(TYPE, __private)
 
+// Byte and short vectors only have the alignment of their element here. Use
+// under-aligned vector types, so the access stays one vector load / store and
+// the backend picks the unaligned gather or splits the store as needed.
+#define DECL_BYTE_UNALIGNED_TYPE(TYPE, DIM) \
+typedef TYPE##DIM __attribute__((aligned(sizeof(TYPE)))) TYPE##DIM##_unaligned;
+
+#define DECL_BYTE_UNALIGNED_TYPES(TYPE) \
+  DECL_BYTE_UNALIGNED_TYPE(TYPE, 2) \
+  DECL_BYTE_UNALIGNED_TYPE(TYPE, 4) \
+  DECL_BYTE_UNALIGNED_TYPE(TYPE, 8) \
+  DECL_BYTE_UNALIGNED_TYPE(TYPE, 16)
+
+#define DECL_BYTE_RD_SPACE_N(TYPE, DIM, SPACE) \
+OVERLOADABLE TYPE##DIM vload##DIM(size_t offset, const SPACE TYPE *p) { \
+  return *(const SPACE TYPE##DIM##_unaligned *) (p + DIM * offset); \
+}
+
+#define DECL_BYTE_WR_SPACE_N(TYPE, DIM, SPACE) \
+OVERLOADABLE void vstore##DIM(TYPE##DIM v, size_t offset, SPACE TYPE *p) { \
+  *(SPACE TYPE##DIM##_unaligned *) (p + DIM * offset) = v; \
+}
+
 #define DECL_BYTE_RD_SPACE(TYPE, SPACE) \
-OVERLOADABLE TYPE##2 vload2(size_t offset, const SPACE TYPE *p) { \
-  return (TYPE##2)(*(p+2*offset), *(p+2*offset+1)); \
-} \
+  DECL_BYTE_RD_SPACE_N(TYPE, 2, SPACE) \
 OVERLOADABLE TYPE##3 vload3(size_t offset, const SPACE TYPE *p) { \
   return (TYPE##3)(*(p+3*offset), *(p+3*offset+1), *(p+3*offset+2)); \
 } \
-OVERLOADABLE TYPE##4 vload4(size_t offset, const SPACE TYPE *p) { \
-  return (TYPE##4)(vload2(2*offset, p), vload2(2*offset, p+2)); \
-} \
-OVERLOADABLE TYPE##8 vload8(size_t offset, const SPACE TYPE *p) { \
-  return (TYPE##8)(vload4(2*offset, p), vload4(2*offset, p+4)); \
-} \
-OVERLOADABLE TYPE##16 vload16(size_t offset, const SPACE TYPE *p) { \
-  return (TYPE##16)(vload8(2*offset, p), vload8(2*offset, p+8)); \
-}
+  DECL_BYTE_RD_SPACE_N(TYPE, 4, SPACE) \
+  DECL_BYTE_RD_SPACE_N(TYPE, 8, SPACE) \
+  DECL_BYTE_RD_SPACE_N(TYPE, 16, SPACE)
 
 #define DECL_BYTE_WR_SPACE(TYPE, SPACE) \
-OVERLOADABLE void vstore2(TYPE##2 v, size_t offset, SPACE TYPE *p) {\
-  *(p + 2 * offset) = v.s0; \
-  *(p + 2 * offset + 1) = v.s1; \
-} \
+  DECL_BYTE_WR_SPACE_N(TYPE, 2, SPACE) \
 OVERLOADABLE void vstore3(TYPE##3 v, size_t offset, SPACE TYPE *p) {\
   *(p + 3 * offset) = v.s0; \
   *(p + 3 * offset + 1) = v.s1; \
   *(p + 3 * offset + 2) = v.s2; \
 } \
-OVERLOADABLE void vstore4(TYPE##4 v, size_t offset, SPACE TYPE *p) { \
-  vstore2(v.lo, 2*offset, p); \
-  vstore2(v.hi, 2*offset, p+2); \
-} \
-OVERLOADABLE void vstore8(TYPE##8 v, size_t offset, SPACE TYPE *p) { \
-  vstore4(v.lo, 2*offset, p); \
-  vstore4(v.hi, 2*offset, p+4); \
-} \
-OVERLOADABLE void vstore16(TYPE##16 v, size_t offset, SPACE TYPE *p) { \
-  vstore8(v.lo, 2*offset, p); \
-  vstore8(v.hi, 2*offset, p+8); \
-}
+  DECL_BYTE_WR_SPACE_N(TYPE, 4, SPACE) \
+  DECL_BYTE_WR_SPACE_N(TYPE, 8, SPACE) \
+  DECL_BYTE_WR_SPACE_N(TYPE, 16, SPACE)
 
 #define DECL_BYTE_RW_ALL(TYPE) \
+  DECL_BYTE_UNALIGNED_TYPES(TYPE) \
   DECL_BYTE_RD_SPACE(TYPE, __global) \
   DECL_BYTE_RD_SPACE(TYPE, __local) \
   DECL_BYTE_RD_SPACE(TYPE, __private) \
@@ -138,6 +141,10 @@ DECL_UNTYPED_RW_ALL(double)
 #undef DECL_UNTYPED_RD_SPACE_N
 #undef DECL_UNTYPED_V3_SPACE
 #undef DECL_UNTYPED_RDV3_SPACE
+#undef DECL_BYTE_UNALIGNED_TYPE
+#undef DECL_BYTE_UNALIGNED_TYPES
+#undef DECL_BYTE_RD_SPACE_N
+#undef DECL_BYTE_WR_SPACE_N
 #undef DECL_BYTE_RD_SPACE
 #undef DECL_BYTE_WR_SPACE
 #undef DECL_BYTE_RW_ALL
@@ -38,15 +38,20 @@ CONST float __gen_ocl_rnde(float x) __asm("llvm.rint" ".f32");
 CONST float __gen_ocl_rndu(float x) __asm("llvm.ceil" ".f32");
 CONST float __gen_ocl_rndd(float x) __asm("llvm.floor" ".f32");
 
+OVERLOADABLE float __gen_ocl_internal_fastpath_reduce_2pi (float x);
+
 OVERLOADABLE float __gen_ocl_internal_fastpath_sincos (float x, __global float *cosval) {
+    x = __gen_ocl_internal_fastpath_reduce_2pi(x);
     *cosval = native_cos(x);
     return native_sin(x);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_sincos (float x, __local float *cosval) {
+    x = __gen_ocl_internal_fastpath_reduce_2pi(x);
     *cosval = native_cos(x);
     return native_sin(x);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_sincos (float x, __private float *cosval) {
+    x = __gen_ocl_internal_fastpath_reduce_2pi(x);
     *cosval = native_cos(x);
     return native_sin(x);
 }
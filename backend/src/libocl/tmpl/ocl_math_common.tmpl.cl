@@ -48,6 +48,11 @@ CONST float __gen_ocl_rndz(float x) __asm("llvm.trunc" ".f32");
 CONST float __gen_ocl_rnde(float x) __asm("llvm.rint" ".f32");
 CONST float __gen_ocl_rndu(float x) __asm("llvm.ceil" ".f32");
 CONST float __gen_ocl_rndd(float x) __asm("llvm.floor" ".f32");
+CONST half __gen_ocl_half_fabs(half x) __asm("llvm.fabs" ".f16");
+CONST half __gen_ocl_half_rndz(half x) __asm("llvm.trunc" ".f16");
+CONST half __gen_ocl_half_rnde(half x) __asm("llvm.rint" ".f16");
+CONST half __gen_ocl_half_rndu(half x) __asm("llvm.ceil" ".f16");
+CONST half __gen_ocl_half_rndd(half x) __asm("llvm.floor" ".f16");
 
 
 /* native functions */
@@ -73,6 +78,16 @@ OVERLOADABLE float native_exp10(float x) { return __gen_ocl_exp(M_LOG210_F*x); }
 OVERLOADABLE float native_divide(float x, float y) { return x/y; }
 
 /* Fast path */
+/* The Gen math unit loses precision quickly outside of [-pi, pi], fold the
+ * argument back with a two constants Cody-Waite step before using it. */
+OVERLOADABLE float __gen_ocl_internal_fastpath_reduce_2pi (float x) {
+    float k = __gen_ocl_rnde(x * 0.15915494309f);
+    x = mad(k, -6.28318548203f, x);
+    return mad(k, 1.7484555e-7f, x);
+}
+OVERLOADABLE float __gen_ocl_internal_fastpath_reduce_2 (float x) {
+    return x - 2.0f * __gen_ocl_rnde(x * 0.5f);
+}
 OVERLOADABLE float __gen_ocl_internal_fastpath_acosh (float x) {
     return native_log(x + native_sqrt(x + 1) * native_sqrt(x - 1));
 }
@@ -86,13 +101,13 @@ OVERLOADABLE float __gen_ocl_internal_fastpath_cbrt (float x) {
     return __gen_ocl_pow(x, 0.3333333333f);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_cos (float x) {
-    return native_cos(x);
+    return native_cos(__gen_ocl_internal_fastpath_reduce_2pi(x));
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_cosh (float x) {
     return (1 + native_exp(-2 * x)) / (2 * native_exp(-x));
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_cospi (float x) {
-    return __gen_ocl_cos(x * M_PI_F);
+    return __gen_ocl_cos(__gen_ocl_internal_fastpath_reduce_2(x) * M_PI_F);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_exp (float x) {
     return native_exp(x);
@@ -137,17 +152,20 @@ OVERLOADABLE float __gen_ocl_internal_fastpath_rootn(float x, int n) {
     return __gen_ocl_pow(x, 1.f / n);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_sin (float x) {
-    return native_sin(x);
+    return native_sin(__gen_ocl_internal_fastpath_reduce_2pi(x));
 }
 
 OVERLOADABLE float __gen_ocl_internal_fastpath_sinh (float x) {
     return (1 - native_exp(-2 * x)) / (2 * native_exp(-x));
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_sinpi (float x) {
-    return __gen_ocl_sin(x * M_PI_F);
+    return __gen_ocl_sin(__gen_ocl_internal_fastpath_reduce_2(x) * M_PI_F);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_tan (float x) {
-    return native_tan(x);
+    return native_tan(__gen_ocl_internal_fastpath_reduce_2pi(x));
+}
+OVERLOADABLE float __gen_ocl_internal_fastpath_tanpi (float x) {
+    return native_tan(__gen_ocl_internal_fastpath_reduce_2(x) * M_PI_F);
 }
 OVERLOADABLE float __gen_ocl_internal_fastpath_tanh (float x) {
     float y = native_exp(-2 * x);
@@ -2226,6 +2244,9 @@ OVERLOADABLE float asinh(float x) {
 }
 
 OVERLOADABLE float tanpi(float x) {
+  if (__ocl_math_fastpath_flag)
+    return __gen_ocl_internal_fastpath_tanpi(x);
+
   return __gen_ocl_internal_tanpi(x);
 }
 
@@ -3263,7 +3284,9 @@ OVERLOADABLE float nextafter(float x, float y) {
 }
 
 /* So far, the HW do not support half float math function.
-   We just do the conversion and call the float version here. */
+   We just do the conversion and call the float version here.
+   Exact operations (fabs and the roundings) stay in half, the backend
+   decides whether the target needs to widen them. */
 OVERLOADABLE half cospi(half x) {
   float _x = (float)x;
   return (half)cospi(_x);
@@ -3381,8 +3404,7 @@ OVERLOADABLE half cbrt(half x) {
   return (half)cbrt(_x);
 }
 OVERLOADABLE half rint(half x) {
-  float _x = (float)x;
-  return (half)rint(_x);
+  return __gen_ocl_half_rnde(x);
 }
 OVERLOADABLE half copysign(half x, half y) {
   float _x = (float)x;
@@ -3423,24 +3445,20 @@ OVERLOADABLE half pow(half x, half y) {
 }
 //no pow, we use powr instead
 OVERLOADABLE half fabs(half x) {
-  float _x = (float)x;
-  return (half)fabs(_x);
+  return __gen_ocl_half_fabs(x);
 }
 OVERLOADABLE half trunc(half x) {
-  float _x = (float)x;
-  return (half)trunc(_x);
+  return __gen_ocl_half_rndz(x);
 }
 OVERLOADABLE half round(half x) {
   float _x = (float)x;
   return (half)round(_x);
 }
 OVERLOADABLE half floor(half x) {
-  float _x = (float)x;
-  return (half)floor(_x);
+  return __gen_ocl_half_rndd(x);
 }
 OVERLOADABLE half ceil(half x) {
-  float _x = (float)x;
-  return (half)ceil(_x);
+  return __gen_ocl_half_rndu(x);
 }
 OVERLOADABLE half log(half x) {
   float _x = (float)x;
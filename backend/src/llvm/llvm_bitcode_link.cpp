@@ -21,12 +21,17 @@
 #include <iostream>
 #include <sstream>
 #include <set>
+#include <map>
+#include <mutex>
 
 #include "sys/cvar.hpp"
 #include "src/GBEConfig.h"
 #include "llvm_includes.hpp"
 #include "llvm/llvm_gen_backend.hpp"
 #include "ir/unit.hpp"
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+#include <llvm/Bitcode/BitcodeReader.h>
+#endif
 
 using namespace llvm;
 
@@ -35,9 +40,146 @@ SVAR(OCL_BITCODE_LIB_20_PATH, OCL_BITCODE_BIN_20);
 
 namespace gbe
 {
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+  /*! The builtin library parsed once in its own context and shared by all the
+   *  builds. It is never modified, only the functions a build needs are cloned
+   *  out of it, under the lock as that creates values in its context. */
+  struct OclBitCodeLib
+  {
+    std::mutex lock;
+    LLVMContext ctx;
+    std::unique_ptr<Module> module;
+    /*! Functions and variables each global value directly refers to */
+    std::map<const GlobalValue *, std::vector<const GlobalValue *>> refs;
+  };
+
+  static void collectGlobalRefs(const Value *value, std::set<const Value *> &visited,
+                                std::vector<const GlobalValue *> &refs)
+  {
+    if (const GlobalValue *GV = dyn_cast<GlobalValue>(value)) {
+      if (visited.insert(GV).second)
+        refs.push_back(GV);
+      return;
+    }
+    const Constant *C = dyn_cast<Constant>(value);
+    if (C == NULL || !visited.insert(C).second)
+      return;
+    for (const Use &op : C->operands())
+      collectGlobalRefs(op.get(), visited, refs);
+  }
+
+  static OclBitCodeLib *loadOclBitCodeLib(const std::string &path)
+  {
+    OclBitCodeLib *lib = new OclBitCodeLib;
+    SMDiagnostic Err;
+    lib->module = parseIRFile(path, Err, lib->ctx);
+    if (!lib->module) {
+      delete lib;
+      return NULL;
+    }
+
+    for (const Function &F : *lib->module) {
+      std::set<const Value *> visited;
+      std::vector<const GlobalValue *> &refs = lib->refs[&F];
+      for (const BasicBlock &BB : F)
+        for (const Instruction &I : BB)
+          for (const Use &op : I.operands())
+            collectGlobalRefs(op.get(), visited, refs);
+    }
+    for (const GlobalVariable &GV : lib->module->globals()) {
+      std::set<const Value *> visited;
+      if (GV.hasInitializer())
+        collectGlobalRefs(GV.getInitializer(), visited, lib->refs[&GV]);
+    }
+    return lib;
+  }
+
+  /*! Parse each library file once, the libraries stay resident for the life of
+   *  the process */
+  static OclBitCodeLib *getOclBitCodeLib(const std::string &path)
+  {
+    static std::mutex libsLock;
+    static std::map<std::string, OclBitCodeLib *> libs;
+    std::lock_guard<std::mutex> guard(libsLock);
+    auto it = libs.find(path);
+    if (it != libs.end())
+      return it->second;
+    OclBitCodeLib *lib = loadOclBitCodeLib(path);
+    if (lib != NULL)
+      libs[path] = lib;
+    return lib;
+  }
+
+  /*! Copy into ctx the library functions in roots and all they depend on */
+  static Module *cloneOclBitCodeClosure(OclBitCodeLib *lib, LLVMContext &ctx,
+                                        const std::set<std::string> &roots)
+  {
+    std::set<const GlobalValue *> closure;
+    std::vector<const GlobalValue *> worklist;
+    SmallVector<char, 0> buffer;
+
+    for (const std::string &name : roots) {
+      const GlobalValue *GV = lib->module->getNamedValue(name);
+      if (GV != NULL && closure.insert(GV).second)
+        worklist.push_back(GV);
+    }
+    while (!worklist.empty()) {
+      const GlobalValue *GV = worklist.back();
+      worklist.pop_back();
+      auto refs = lib->refs.find(GV);
+      if (refs == lib->refs.end())
+        continue;
+      for (const GlobalValue *ref : refs->second)
+        if (closure.insert(ref).second)
+          worklist.push_back(ref);
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lib->lock);
+      ValueToValueMapTy VMap;
+#if LLVM_VERSION_MAJOR >= 7
+      std::unique_ptr<Module> part = CloneModule(*lib->module, VMap,
+#else
+      std::unique_ptr<Module> part = CloneModule(lib->module.get(), VMap,
+#endif
+        [&](const GlobalValue *GV) { return closure.count(GV) != 0; });
+
+      /* Every other library function is left as a declaration, drop them */
+      for (Module::iterator F = part->begin(); F != part->end();) {
+        Function &func = *F++;
+        if (func.isDeclaration() && func.use_empty())
+          func.eraseFromParent();
+      }
+      for (Module::global_iterator G = part->global_begin(); G != part->global_end();) {
+        GlobalVariable &var = *G++;
+        if (var.isDeclaration() && var.use_empty())
+          var.eraseFromParent();
+      }
+
+      raw_svector_ostream stream(buffer);
+#if LLVM_VERSION_MAJOR >= 7
+      WriteBitcodeToFile(*part, stream);
+#else
+      WriteBitcodeToFile(part.get(), stream);
+#endif
+    }
+
+    Expected<std::unique_ptr<Module>> module =
+      parseBitcodeFile(MemoryBufferRef(StringRef(buffer.data(), buffer.size()), "ocl_lib"), ctx);
+    if (!module) {
+      handleAllErrors(module.takeError(), [&](ErrorInfoBase &EIB) {
+        printf("Fatal Error: ocl lib can not be cloned, because %s\n", EIB.message().c_str());
+      });
+      return NULL;
+    }
+    return module->release();
+  }
+#endif
+
   static Module* createOclBitCodeModule(LLVMContext& ctx,
                                                  bool strictMath,
-                                                 uint32_t oclVersion)
+                                                 uint32_t oclVersion,
+                                                 const std::set<std::string> &roots)
   {
     std::string bitCodeFiles = oclVersion >= 200 ?
                                OCL_BITCODE_LIB_20_PATH : OCL_BITCODE_LIB_PATH;
@@ -60,6 +202,24 @@ namespace gbe
       return NULL;
     }
 
+#if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 40
+    OclBitCodeLib *lib = getOclBitCodeLib(FilePath);
+    if (lib == NULL) {
+      printf("Fatal Error: ocl lib can not be opened\n");
+      return NULL;
+    }
+    oclLib = cloneOclBitCodeClosure(lib, ctx, roots);
+    if (!oclLib)
+      return NULL;
+
+    /* Only there when a cloned function uses it */
+    llvm::GlobalVariable* mathFastFlag = oclLib->getGlobalVariable("__ocl_math_fastpath_flag");
+    if (mathFastFlag) {
+      Type* intTy = IntegerType::get(ctx, 32);
+      mathFastFlag->setInitializer(ConstantInt::get(intTy, strictMath ? 0 : 1));
+    }
+    return oclLib;
+#else
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR <= 35
     oclLib = getLazyIRFileModule(FilePath, Err, ctx);
 #else
@@ -76,6 +236,7 @@ namespace gbe
     mathFastFlag->setInitializer(ConstantInt::get(intTy, strictMath ? 0 : 1));
 
     return oclLib;
+#endif
   }
 
   static bool materializedFuncCall(Module& src, Module& lib, llvm::Function& KF,
@@ -160,9 +321,6 @@ namespace gbe
     uint32_t oclVersion = getModuleOclVersion(mod);
     ir::PointerSize size = oclVersion >= 200 ? ir::POINTER_64_BITS : ir::POINTER_32_BITS;
     unit.setPointerSize(size);
-    Module* clonedLib = createOclBitCodeModule(ctx, strictMath, oclVersion);
-    if (clonedLib == NULL)
-      return NULL;
 
     std::vector<const char *> kernels;
     std::vector<const char *> kerneltmp;
@@ -224,6 +382,17 @@ namespace gbe
       builtinFuncs.push_back("__gen_memset_n_align");
     }
 
+    /* The library functions the module may call, and the ones the backend
+       may call for memcpy and memset */
+    std::set<std::string> libRoots(builtinFuncs.begin(), builtinFuncs.end());
+    for (Module::iterator SF = mod->begin(), E = mod->end(); SF != E; ++SF)
+      if (SF->isDeclaration() && !SF->isIntrinsic())
+        libRoots.insert(SF->getName().str());
+
+    Module* clonedLib = createOclBitCodeModule(ctx, strictMath, oclVersion, libRoots);
+    if (clonedLib == NULL)
+      return NULL;
+
     for (Module::iterator SF = mod->begin(), E = mod->end(); SF != E; ++SF) {
       if (SF->isDeclaration()) continue;
       if (!isKernelFunction(*SF)) continue;
@@ -4176,13 +4176,8 @@ namespace gbe
 
   void GenWriter::emitRoundingCallInst(CallInst &I, CallSite &CS, ir::Opcode opcode) {
     if (I.getType()->isHalfTy()) {
-      const ir::Register src = this->getRegister(I.getOperand(0));
-      const ir::Register srcFloat = ctx.reg(ir::FAMILY_DWORD);
-      const ir::Register dstFloat = ctx.reg(ir::FAMILY_DWORD);
-      const ir::Register dst = this->getRegister(&I);
-      ctx.F16TO32(ir::TYPE_FLOAT, ir::TYPE_U16, srcFloat, src);
-      ctx.ALU1(opcode, ir::TYPE_FLOAT, dstFloat, srcFloat);
-      ctx.F32TO16(ir::TYPE_U16, ir::TYPE_FLOAT, dst, dstFloat);
+      // The instruction selection widens to float if the target can't round HF
+      this->emitUnaryCallInst(I,CS,opcode,ir::TYPE_HALF);
     } else {
       GBE_ASSERT(I.getType()->isFloatTy());
       this->emitUnaryCallInst(I,CS,opcode);
@@ -6021,8 +6016,11 @@ namespace gbe
           emitBatchLoadOrStore(type, elemNum, llvmValues, elemType);
         }
       }
-      else if((dataFamily == ir::FAMILY_WORD && (isLoad || elemNum % 2 == 0)) ||
-              (dataFamily == ir::FAMILY_BYTE && (isLoad || elemNum % 4 == 0))) {
+      // Byte/word vector stores are packed into dwords and written with untyped
+      // writes, which needs a dword aligned address. The loads handle any
+      // alignment with the unaligned byte gather.
+      else if((dataFamily == ir::FAMILY_WORD && (isLoad || (dwAligned && elemNum % 2 == 0))) ||
+              (dataFamily == ir::FAMILY_BYTE && (isLoad || (dwAligned && elemNum % 4 == 0)))) {
           emitBatchLoadOrStore(type, elemNum, llvmValues, elemType);
       } else {
         for (uint32_t elemID = 0; elemID < elemNum; elemID++) {
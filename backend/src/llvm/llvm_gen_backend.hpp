@@ -151,7 +151,7 @@ namespace gbe
 
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 35
   /* customized loop unrolling pass. */
-  llvm::LoopPass *createCustomLoopUnrollPass();
+  llvm::LoopPass *createCustomLoopUnrollPass(ir::Unit &unit);
 #endif
   llvm::FunctionPass* createSamplerFixPass();
 
@@ -99,7 +99,8 @@ namespace gbe
     FPM.doFinalization();
   }
 
-  void runModulePass(Module &mod, TARGETLIBRARY *libraryInfo, const DataLayout &DL, int optLevel, bool strictMath)
+  void runModulePass(Module &mod, TARGETLIBRARY *libraryInfo, const DataLayout &DL, int optLevel,
+                     bool strictMath, bool customUnroll, ir::Unit &unit)
   {
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 37
     legacy::PassManager MPM;
@@ -188,7 +189,8 @@ namespace gbe
     // As we observe this under strict math. So we disable CustomLoopUnroll if strict math is enabled.
     if (!strictMath) {
 #if !defined(__ANDROID__)
-      MPM.add(createCustomLoopUnrollPass()); //1024, 32, 1024, 512)); //Unroll loops
+      if (customUnroll)
+        MPM.add(createCustomLoopUnrollPass(unit)); //1024, 32, 1024, 512)); //Unroll loops
 #endif
       MPM.add(createLoopUnrollPass()); //1024, 32, 1024, 512)); //Unroll loops
       if(optLevel > 0) {
@@ -282,7 +284,8 @@ namespace gbe
   }
 
   bool llvmToGen(ir::Unit &unit, const void* module,
-                 int optLevel, bool strictMath, int profiling, std::string &errors)
+                 int optLevel, bool strictMath, int profiling, std::string &errors,
+                 bool customUnroll)
   {
     std::string errInfo;
     std::unique_ptr<llvm::raw_fd_ostream> o = NULL;
@@ -338,7 +341,7 @@ namespace gbe
     OUTPUT_BITCODE(AFTER_LINK, mod);
 
     runFuntionPass(mod, libraryInfo, DL);
-    runModulePass(mod, libraryInfo, DL, optLevel, strictMath);
+    runModulePass(mod, libraryInfo, DL, optLevel, strictMath, customUnroll, unit);
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 37
     legacy::PassManager passes;
 #else
@@ -34,9 +34,11 @@ namespace gbe {
   } /* namespace ir */
 
   /*! Convert the LLVM IR code to a GEN IR code,
-		  optLevel 0 equal to clang -O1 and 1 equal to clang -O2*/
+		  optLevel 0 equal to clang -O1 and 1 equal to clang -O2,
+		  customUnroll lets loops be unrolled beyond the LLVM heuristics*/
   bool llvmToGen(ir::Unit &unit, const void* module,
-                 int optLevel, bool strictMath, int profiling, std::string &errors);
+                 int optLevel, bool strictMath, int profiling, std::string &errors,
+                 bool customUnroll = true);
 } /* namespace gbe */
 
 #endif /* __GBE_IR_LLVM_TO_GEN_HPP__ */
@@ -22,6 +22,7 @@
 #include "llvm_includes.hpp"
 
 #include "llvm/llvm_gen_backend.hpp"
+#include "ir/unit.hpp"
 #include "sys/map.hpp"
 
 
@@ -32,8 +33,8 @@ namespace gbe {
     {
     public:
       static char ID;
-      CustomLoopUnroll() :
-       LoopPass(ID) {}
+      CustomLoopUnroll(ir::Unit &unit) :
+       LoopPass(ID), unit(unit) {}
 
       void getAnalysisUsage(AnalysisUsage &AU) const {
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 37
@@ -154,6 +155,91 @@ namespace gbe {
         }
         return false;
       }
+
+      /*! Gen has 128 GRFs of 32 bytes, keep some of them for the thread
+       *  payload and the temporaries added by the instruction selection */
+      static const uint32_t simd16GRFBudget = 96;
+      static const uint32_t simd16Lanes = 16;
+      static const uint32_t grfSize = 32;
+
+      // Number of GRFs taken by one SIMD16 value, 0 for the values which
+      // are not held in registers.
+      uint32_t getValueGRFs(const Value *V) const {
+        Type *Ty = V->getType();
+        if (!Ty->isIntegerTy() && !Ty->isFloatingPointTy() &&
+            !Ty->isPointerTy() && !Ty->isVectorTy())
+          return 0;
+        const uint32_t bytes = getTypeByteSize(unit, Ty) * simd16Lanes;
+        return (bytes + grfSize - 1) / grfSize;
+      }
+
+      // The private array a load or store address points to, if any.
+      static const AllocaInst *getPrivateArray(const Value *ptr) {
+        for (;;) {
+          if (const GetElementPtrInst *gep = dyn_cast<GetElementPtrInst>(ptr))
+            ptr = gep->getPointerOperand();
+          else if (const BitCastInst *cast = dyn_cast<BitCastInst>(ptr))
+            ptr = cast->getOperand(0);
+          else
+            break;
+        }
+        return dyn_cast<AllocaInst>(ptr);
+      }
+
+      // Fast register pressure estimate of the loop once fully unrolled,
+      // before any Gen IR exists. The private arrays it accesses get promoted
+      // to registers, on top of the values live across the loop blocks and
+      // the peak of the values local to one block. The values the loop
+      // defines are there once per iteration, the invariant ones only once.
+      uint32_t estimateUnrolledPressure(Loop *L, unsigned tripCount) const {
+        std::set<const AllocaInst*> arrays;
+        std::set<const Value*> liveAcross;
+        uint32_t arrayGRFs = 0, invariantGRFs = 0, acrossGRFs = 0, localPeak = 0;
+
+        for (auto bb : L->getBlocks()) {
+          std::set<const Value*> live;
+          uint32_t liveGRFs = 0;
+          for (BasicBlock::reverse_iterator it = bb->rbegin(), itE = bb->rend(); it != itE; ++it) {
+            const Instruction *insn = &*it;
+            if (live.erase(insn))
+              liveGRFs -= getValueGRFs(insn);
+
+            const Value *ptr = NULL;
+            if (const LoadInst *ld = dyn_cast<LoadInst>(insn)) {
+              if (ld->getPointerAddressSpace() == 0)
+                ptr = ld->getPointerOperand();
+            } else if (const StoreInst *st = dyn_cast<StoreInst>(insn)) {
+              if (st->getPointerAddressSpace() == 0)
+                ptr = st->getPointerOperand();
+            }
+            const AllocaInst *array = ptr ? getPrivateArray(ptr) : NULL;
+            if (array && arrays.insert(array).second) {
+              uint32_t bytes = getTypeByteSize(unit, array->getAllocatedType());
+              if (const ConstantInt *num = dyn_cast<ConstantInt>(array->getArraySize()))
+                bytes *= num->getZExtValue();
+              arrayGRFs += bytes * simd16Lanes / grfSize;
+            }
+
+            for (const Value *op : insn->operands()) {
+              if (isa<AllocaInst>(op) || (!isa<Instruction>(op) && !isa<Argument>(op)))
+                continue;
+              const Instruction *def = dyn_cast<Instruction>(op);
+              if (def && def->getParent() == bb && !isa<PHINode>(insn)) {
+                if (live.insert(op).second)
+                  liveGRFs += getValueGRFs(op);
+              } else if (liveAcross.insert(op).second) {
+                if (def && L->contains(def))
+                  acrossGRFs += getValueGRFs(op);
+                else
+                  invariantGRFs += getValueGRFs(op);
+              }
+            }
+            localPeak = std::max(localPeak, liveGRFs);
+          }
+        }
+        return arrayGRFs + invariantGRFs + std::max(tripCount, 1u) * (acrossGRFs + localPeak);
+      }
+
       // If one loop has very large self trip count
       // we don't want to unroll it.
       // self trip count means trip count divide by the parent's trip count. for example
@@ -166,8 +252,8 @@ namespace gbe {
       //   }
       // The inner loops j and k could be unrolled, but the loop i will not be unrolled.
       // The return value true means the L could be unrolled, otherwise, it could not
-      // be unrolled.
-      bool handleParentLoops(Loop *L, LPPassManager &LPM) {
+      // be unrolled. tripCount is the self trip count of L, 0 if unknown.
+      bool handleParentLoops(Loop *L, LPPassManager &LPM, unsigned &tripCount) {
         Loop *currL = L;
 #if LLVM_VERSION_MAJOR * 10 + LLVM_VERSION_MINOR >= 38
         ScalarEvolution *SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
@@ -183,6 +269,7 @@ namespace gbe {
         bool shouldUnroll = true;
         if (ExitBlock)
           currTripCount = SE->getSmallConstantTripCount(L, ExitBlock);
+        tripCount = currTripCount;
 
         if (currTripCount > 32) {
           shouldUnroll = false;
@@ -223,7 +310,8 @@ namespace gbe {
 
       // Analyze the outermost BBs of this loop, if there are
       // some private load or store, we change it's loop meta data
-      // to indicate more aggresive unrolling on it.
+      // to indicate more aggresive unrolling on it, as long as the
+      // unrolled loop is still expected to fit in the SIMD16 registers.
       virtual bool runOnLoop(Loop *L, LPPassManager &LPM) {
         const MDNode *Enable = GetUnrollMetadataValue(L, "llvm.loop.unroll.enable");
         if (Enable)
@@ -232,12 +320,17 @@ namespace gbe {
         if (Count > 0)
           return false;
 
-        if (!handleParentLoops(L, LPM))
+        unsigned tripCount = 0;
+        if (!handleParentLoops(L, LPM, tripCount))
           return false;
 
         if (!hasPrivateLoadStore(L))
           return false;
+
+        if (estimateUnrolledPressure(L, tripCount) > simd16GRFBudget)
+          return false;
         setUnrollID(L, true);
+        unit.setForcedUnroll(L->getHeader()->getParent()->getName().str());
         return true;
       }
 
@@ -250,12 +343,14 @@ namespace gbe {
         return "SPIR backend: custom loop unrolling pass";
       }
 
+    private:
+      ir::Unit &unit;
     };
 
     char CustomLoopUnroll::ID = 0;
 
-    LoopPass *createCustomLoopUnrollPass() {
-      return new CustomLoopUnroll();
+    LoopPass *createCustomLoopUnrollPass(ir::Unit &unit) {
+      return new CustomLoopUnroll(unit);
     }
 } // end namespace
 #endif
@@ -34,6 +34,13 @@ clReportUnfreedIntel(void);
 
 typedef CL_API_ENTRY cl_int (CL_API_CALL *clReportUnfreedIntel_fn)(void);
 
+/* Report the number of kernel code uploads alive in the process. Kernels
+ * with identical code share one upload, in any context */
+extern CL_API_ENTRY cl_int CL_API_CALL
+clReportKernelUploadsIntel(void);
+
+typedef CL_API_ENTRY cl_int (CL_API_CALL *clReportKernelUploadsIntel_fn)(void);
+
 /* 1 to 1 mapping of drm_intel_bo_map */
 extern CL_API_ENTRY void* CL_API_CALL
 clMapBufferIntel(cl_mem, cl_int*);
@@ -203,6 +210,12 @@ typedef CL_API_ENTRY cl_int
 #define CL_KERNEL_SPILL_MEM_SIZE_INTEL                  0x4109
 #define CL_KERNEL_COMPILE_SUB_GROUP_SIZE_INTEL          0x410A
 
+/* clGetImageInfo query of the tiling chosen for an image, returns a cl_uint */
+#define CL_IMAGE_TILING_INTEL                           0x410B
+#define CL_IMAGE_TILING_NONE_INTEL                      0
+#define CL_IMAGE_TILING_X_INTEL                         1
+#define CL_IMAGE_TILING_Y_INTEL                         2
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,12 @@
+/* vloadn/vstoren of byte and short vectors on addresses which are only
+ * aligned to the element size */
+__kernel void
+compiler_byte_vload_unaligned(__global uchar *src, __global uchar *dst,
+                              __global ushort *src16, __global ushort *dst16)
+{
+  int x = (int)get_global_id(0);
+  uchar16 v = vload16(x, src + 1);
+  vstore16(v + (uchar16)(1), x, dst + 3);
+  ushort8 s = vload8(x, src16 + 1);
+  vstore8(s + (ushort8)(1), x, dst16 + 3);
+}
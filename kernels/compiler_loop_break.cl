@@ -0,0 +1,14 @@
+__kernel void
+compiler_loop_break(__global int *src, __global int *dst)
+{
+  int id = (int)get_global_id(0);
+  int sum = 0;
+  int i;
+  for (i = 0; i < 32; i++) {
+    int v = src[id + i];
+    if (v < 0)
+      break;
+    sum += v;
+  }
+  dst[id] = sum * 100 + i;
+}
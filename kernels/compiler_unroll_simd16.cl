@@ -0,0 +1,15 @@
+/* Loops over private arrays the custom unrolling forces, heavy enough for the
+ * unrolled kernel to be close to the SIMD16 register budget */
+kernel void compiler_unroll_simd16(__global const float *src, __global float *dst)
+{
+  int id = get_global_id(0);
+  float a[24], b[24];
+  for (int i = 0; i < 24; i++) {
+    a[i] = src[id * 24 + i];
+    b[i] = a[i] * (i + 1);
+  }
+  float sum = 0.f;
+  for (int i = 0; i < 24; i++)
+    sum += a[i] * b[23 - i];
+  dst[id] = sum;
+}
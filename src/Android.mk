@@ -76,6 +76,7 @@ endef
 $(foreach KERNEL_NAME, ${KERNEL_NAMES}, $(eval $(call GEN_INTERNAL_KER,$(KERNEL_NAME))))
 
 $(shell $(GBE_BIN_GENERATER) -s $(KERNEL_PATH)/$(BUILT_IN_NAME).cl -o $(KERNEL_PATH)/$(BUILT_IN_NAME)_str.c)
+$(shell $(GBE_BIN_GENERATER) -s $(KERNEL_PATH)/cl_internal_self_test.cl -o $(KERNEL_PATH)/cl_internal_self_test_str.c)
 
 GIT_SHA1 = git_sha1.h
 $(shell chmod +x $(LOCAL_PATH)/git_sha1.sh)
@@ -84,6 +85,7 @@ $(shell $(LOCAL_PATH)/git_sha1.sh $(LOCAL_PATH) ${GIT_SHA1})
 LOCAL_SRC_FILES:= \
     $(addprefix kernels/,$(addsuffix _str.c, $(KERNEL_NAMES))) \
     $(addprefix kernels/,$(addsuffix _str.c, $(BUILT_IN_NAME))) \
+    kernels/cl_internal_self_test_str.c \
     cl_base_object.c \
     cl_api.c \
     cl_api_platform_id.c \
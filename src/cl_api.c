@@ -1028,7 +1028,7 @@ clSetKernelArg(cl_kernel     kernel,
     err = cmrt_set_kernel_arg(kernel, arg_index, arg_size, arg_value);
   else
 #endif
-    err = cl_kernel_set_arg(kernel, arg_index, arg_size, arg_value);
+    err = cl_kernel_stage_arg(kernel, arg_index, arg_size, arg_value, CL_FALSE);
 error:
   return err;
 }
@@ -1041,7 +1041,7 @@ clSetKernelArgSVMPointer(cl_kernel kernel,
   cl_int err = CL_SUCCESS;
   CHECK_KERNEL(kernel);
 
-  err = cl_kernel_set_arg_svm_pointer(kernel, arg_index, arg_value);
+  err = cl_kernel_stage_arg(kernel, arg_index, 0, arg_value, CL_TRUE);
 error:
   return err;
 }
@@ -1257,6 +1257,7 @@ internal_clGetExtensionFunctionAddress(const char *func_name)
   EXTFUNC(clPinBufferIntel)
   EXTFUNC(clUnpinBufferIntel)
   EXTFUNC(clReportUnfreedIntel)
+  EXTFUNC(clReportKernelUploadsIntel)
   EXTFUNC(clCreateBufferFromLibvaIntel)
   EXTFUNC(clCreateImageFromLibvaIntel)
   EXTFUNC(clGetMemObjectFdIntel)
@@ -1293,6 +1294,12 @@ clReportUnfreedIntel(void)
   return cl_report_unfreed();
 }
 
+cl_int
+clReportKernelUploadsIntel(void)
+{
+  return cl_kernel_isa_upload_n();
+}
+
 void*
 clMapBufferIntel(cl_mem mem, cl_int *errcode_ret)
 {
@@ -88,9 +88,11 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
   size_t fixed_global_off[] = {0, 0, 0};
   size_t fixed_global_sz[] = {1, 1, 1};
   size_t fixed_local_sz[] = {1, 1, 1};
+  cl_int tune_slot = -1;
   cl_int err = CL_SUCCESS;
   cl_uint i;
   cl_event e = NULL;
+  cl_kernel launch = NULL;
   cl_int event_status;
 
   do {
@@ -151,19 +153,10 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
         fixed_local_sz[0] = 16;
         fixed_local_sz[1] = 1;
       } else {
-        uint j, maxDimSize = 64 /* from 64? */, maxGroupSize = 256; //MAX_WORK_GROUP_SIZE may too large
         size_t realGroupSize = 1;
-        for (i = 0; i < work_dim; i++) {
-          for (j = maxDimSize; j > 1; j--) {
-            if (global_work_size[i] % j == 0 && j <= maxGroupSize) {
-              fixed_local_sz[i] = j;
-              maxGroupSize = maxGroupSize / j;
-              maxDimSize = maxGroupSize > maxDimSize ? maxDimSize : maxGroupSize;
-              break; //choose next work_dim
-            }
-          }
+        tune_slot = cl_kernel_advise_local_sz(kernel, work_dim, global_work_size, fixed_local_sz);
+        for (i = 0; i < work_dim; i++)
           realGroupSize *= fixed_local_sz[i];
-        }
 
         //in a loop of conformance test (such as test_api repeated_setup_cleanup), in each loop:
         //create a new context, a new command queue, and uses 'globalsize[0]=1000, localsize=NULL' to enqueu kernel
@@ -207,6 +200,14 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
       break;
     }
 
+    /* Launch with the arguments as they are now, other threads may keep on
+       setting them */
+    launch = cl_kernel_snapshot(kernel);
+    if (launch == NULL) {
+      err = CL_OUT_OF_HOST_MEMORY;
+      break;
+    }
+
     int i, j, k;
     const size_t global_wk_sz_div[3] = {
       fixed_global_sz[0] / fixed_local_sz[0] * fixed_local_sz[0],
@@ -246,8 +247,20 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
             break;
           }
 
+          /* The advised local size always divides the global size */
+          if (tune_slot >= 0) {
+            assert(count == 1);
+            cl_kernel_add_ref(kernel);
+            e->exec_data.tune_kernel = kernel;
+            e->exec_data.tune_slot = tune_slot;
+          }
+
+          /* The event keeps the arguments and their buffers alive */
+          cl_kernel_add_ref(launch);
+          e->exec_data.kernel = launch;
+
           /* Do device specific checks are enqueue the kernel */
-          err = cl_command_queue_ND_range(command_queue, kernel, e, work_dim,
+          err = cl_command_queue_ND_range(command_queue, launch, e, work_dim,
                                           fixed_global_off, global_dim_off, fixed_global_sz,
                                           global_wk_sz_use, fixed_local_sz, local_wk_sz_use);
           if (err != CL_SUCCESS) {
@@ -289,6 +302,8 @@ clEnqueueNDRangeKernel(cl_command_queue command_queue,
   } else {
     cl_event_delete(e);
   }
+  if (launch)
+    cl_kernel_delete(launch);
 
   return err;
 }
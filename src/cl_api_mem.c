@@ -21,6 +21,7 @@
 #include "cl_command_queue.h"
 #include "cl_event.h"
 #include "CL/cl.h"
+#include "CL/cl_intel.h"
 #include <string.h>
 
 cl_int
@@ -213,6 +214,11 @@ clGetImageInfo(cl_mem memobj,
     src_size = sizeof(cl_uint);
     break;
   }
+  case CL_IMAGE_TILING_INTEL:
+    value = image->tiling;
+    src_ptr = &value;
+    src_size = sizeof(cl_uint);
+    break;
   default:
     return CL_INVALID_VALUE;
   }
@@ -306,8 +312,11 @@ clEnqueueMapBuffer(cl_command_queue command_queue,
     data->size = size;
     data->ptr = NULL;
     data->unsync_map = 0;
+    data->gtt_map = 0;
     if (map_flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION))
       data->write_map = 1;
+    if (map_flags & CL_MAP_WRITE_INVALIDATE_REGION)
+      data->invalidate_map = 1;
 
     if (cl_command_queue_allow_bypass_submit(command_queue) && (e_status == CL_COMPLETE)) {
       // Sync mode, no need to queue event.
@@ -329,7 +338,7 @@ clEnqueueMapBuffer(cl_command_queue command_queue,
 
     ptr = data->ptr;
     assert(ptr);
-    err = cl_mem_record_map_mem(buffer, ptr, &mem_ptr, offset, size, NULL, NULL);
+    err = cl_mem_record_map_mem(buffer, ptr, &mem_ptr, offset, size, NULL, NULL, data->gtt_map);
     assert(err == CL_SUCCESS);
   } while (0);
 
@@ -1776,6 +1785,7 @@ clEnqueueMapImage(cl_command_queue command_queue,
     data->region[2] = region[2];
     data->ptr = ptr;
     data->unsync_map = 1;
+    data->gtt_map = 0;
     if (map_flags & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION))
       data->write_map = 1;
 
@@ -1819,7 +1829,7 @@ clEnqueueMapImage(cl_command_queue command_queue,
       offset = image->bpp * origin[0] + image->row_pitch * origin[1] + image->slice_pitch * origin[2];
     }
 
-    err = cl_mem_record_map_mem(mem, ptr, &mem_ptr, offset, 0, origin, region);
+    err = cl_mem_record_map_mem(mem, ptr, &mem_ptr, offset, 0, origin, region, data->gtt_map);
     assert(err == CL_SUCCESS); // Easy way, do not use unmap to handle error.
   } while (0);
 
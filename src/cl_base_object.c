@@ -33,7 +33,7 @@ cl_object_init_base(cl_base_object obj, cl_ulong magic)
 }
 
 LOCAL void
-cl_object_destroy_base(cl_base_object obj)
+cl_object_retire_base(cl_base_object obj)
 {
   int ref = CL_OBJECT_GET_REF(obj);
   if (ref != 0) {
@@ -61,10 +61,37 @@ cl_object_destroy_base(cl_base_object obj)
   }
 
   obj->magic = CL_OBJECT_INVALID_MAGIC;
+}
+
+/* Make a retired object alive again. The mutex and cond are still
+   initialized from the first cl_object_init_base. */
+LOCAL void
+cl_object_revive_base(cl_base_object obj, cl_ulong magic)
+{
+  assert(obj->magic == CL_OBJECT_INVALID_MAGIC);
+  obj->magic = magic;
+  obj->ref = 1;
+  SET_ICD(obj->dispatch);
+  obj->owner = invalid_thread_id;
+  list_node_init(&obj->node);
+}
+
+/* Release the sync objects of a retired object. */
+LOCAL void
+cl_object_free_retired_base(cl_base_object obj)
+{
+  assert(obj->magic == CL_OBJECT_INVALID_MAGIC);
   pthread_mutex_destroy(&obj->mutex);
   pthread_cond_destroy(&obj->cond);
 }
 
+LOCAL void
+cl_object_destroy_base(cl_base_object obj)
+{
+  cl_object_retire_base(obj);
+  cl_object_free_retired_base(obj);
+}
+
 LOCAL cl_int
 cl_object_take_ownership(cl_base_object obj, cl_int wait, cl_bool withlock)
 {
@@ -33,9 +33,29 @@
 #include "cl_cmrt.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+static pthread_once_t batch_max_once = PTHREAD_ONCE_INIT;
+static cl_uint batch_max = CL_QUEUE_BATCH_MAX;
+
+static void
+cl_command_queue_read_batch_max(void)
+{
+  const char *env = getenv("OCL_BATCH_NDRANGE");
+  if (env != NULL)
+    batch_max = atoi(env) > 1 ? atoi(env) : 1;
+}
+
+static cl_uint
+cl_command_queue_batch_max(void)
+{
+  /* Queues may be created from several threads at once */
+  pthread_once(&batch_max_once, cl_command_queue_read_batch_max);
+  return batch_max;
+}
+
 static cl_command_queue
 cl_command_queue_new(cl_context ctx)
 {
@@ -47,7 +67,10 @@ cl_command_queue_new(cl_context ctx)
     return NULL;
 
   CL_OBJECT_INIT_BASE(queue, CL_OBJECT_COMMAND_QUEUE_MAGIC);
+  pthread_mutex_init(&queue->batch_lock, NULL);
+  queue->batch_max = cl_command_queue_batch_max();
   if (cl_command_queue_init_enqueue(queue) != CL_SUCCESS) {
+    pthread_mutex_destroy(&queue->batch_lock);
     cl_free(queue);
     return NULL;
   }
@@ -88,6 +111,8 @@ cl_command_queue_delete(cl_command_queue queue)
   cl_context_remove_queue(queue->ctx, queue);
 
   cl_command_queue_destroy_enqueue(queue);
+  cl_command_queue_flush_batch(queue);
+  pthread_mutex_destroy(&queue->batch_lock);
 
   cl_mem_delete(queue->perf);
   if (queue->barrier_events) {
@@ -181,7 +206,7 @@ cl_command_queue_bind_surface(cl_command_queue queue, cl_kernel k, cl_gpgpu gpgp
           arg_type == GBE_ARG_PIPE) ||
         !k->args[i].mem)
       continue;
-    offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, i);
+    offset = k->dispatch.arg[i];
     if (offset < 0)
       continue;
     bti = interp_kernel_get_arg_bti(k->opaque, i);
@@ -307,6 +332,141 @@ cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
   return CL_SUCCESS;
 }
 
+/* Maps then only wait for the commands using the mapped range. The arguments
+   are taken as written, except the constant ones. */
+LOCAL cl_int
+cl_command_queue_add_busy_ranges(cl_command_queue queue, cl_kernel k, cl_gpgpu gpgpu, cl_event event)
+{
+  enqueue_data *data = &event->exec_data;
+  uint32_t i, n = k->arg_n + k->exec_info_n;
+  enum gbe_arg_type arg_type;
+  cl_bool write;
+  size_t offset, size;
+  cl_mem mem, owner;
+  void *ptr;
+
+  assert(data->busy_mems == NULL);
+  if (n == 0)
+    return CL_SUCCESS;
+  data->busy_mems = cl_calloc(n, sizeof(cl_mem));
+  if (data->busy_mems == NULL)
+    return CL_OUT_OF_HOST_MEMORY;
+
+  for (i = 0; i < n; i++) {
+    offset = 0;
+    write = CL_TRUE;
+    if (i < k->arg_n) {
+      mem = k->args[i].mem;
+      arg_type = interp_kernel_get_arg_type(k->opaque, i);
+      if (mem == NULL || !(arg_type == GBE_ARG_GLOBAL_PTR || arg_type == GBE_ARG_CONSTANT_PTR ||
+                           arg_type == GBE_ARG_IMAGE || arg_type == GBE_ARG_PIPE))
+        continue;
+      if (arg_type == GBE_ARG_CONSTANT_PTR)
+        write = CL_FALSE;
+      if (k->args[i].is_svm)
+        offset = (size_t)k->args[i].ptr - (size_t)mem->host_ptr;
+    } else {
+      ptr = k->exec_info[i - k->arg_n];
+      mem = cl_context_get_svm_from_ptr(k->program->ctx, ptr);
+      if (mem == NULL)
+        mem = cl_context_get_mem_from_ptr(k->program->ctx, ptr);
+      if (mem == NULL)
+        continue;
+      offset = (size_t)ptr - (size_t)mem->host_ptr;
+    }
+
+    /* The size is relative to mem, take it before the offset moves into the owner */
+    if (IS_IMAGE(mem))
+      size = cl_mem_image(mem)->buffer_1d ? cl_mem_image(mem)->buffer_1d->size : mem->size;
+    else
+      size = mem->size - offset;
+    owner = cl_mem_bo_owner(mem, &offset);
+    if (cl_mem_add_busy_range(owner, offset, size, write, queue, gpgpu) != CL_SUCCESS)
+      return CL_OUT_OF_HOST_MEMORY;
+    cl_mem_add_ref(owner);
+    data->busy_mems[data->busy_mem_n++] = owner;
+  }
+
+  return CL_SUCCESS;
+}
+
+/* printf, profiling and device enqueue results are read right after the flush */
+static cl_bool
+cl_command_queue_gpgpu_batchable(cl_gpgpu gpgpu)
+{
+  cl_kernel ker = cl_gpgpu_get_kernel(gpgpu);
+
+  if (cl_gpgpu_get_printf_info(gpgpu) || cl_gpgpu_get_profiling_info(gpgpu))
+    return CL_FALSE;
+  if (ker && ker->useDeviceEnqueue)
+    return CL_FALSE;
+  return CL_TRUE;
+}
+
+/* Must be called with the batch lock */
+static cl_int
+cl_command_queue_flush_batch_locked(cl_command_queue queue)
+{
+  cl_gpgpu head = queue->batch_head;
+
+  if (queue->batch_num == 0)
+    return CL_SUCCESS;
+
+  queue->batch_head = queue->batch_tail = NULL;
+  queue->batch_num = 0;
+  return cl_command_queue_flush_gpgpu(head);
+}
+
+LOCAL cl_int
+cl_command_queue_flush_batch(cl_command_queue queue)
+{
+  cl_int err;
+
+  pthread_mutex_lock(&queue->batch_lock);
+  err = cl_command_queue_flush_batch_locked(queue);
+  pthread_mutex_unlock(&queue->batch_lock);
+  return err;
+}
+
+/* Consecutive kernels are chained in one batch and submitted with one
+   exec, when the batch is full or when someone needs their results. The
+   gpgpus are kept alive by their events until they reach CL_COMPLETE, and
+   getting there flushes the batch first. */
+LOCAL cl_int
+cl_command_queue_submit_gpgpu(cl_command_queue queue, cl_gpgpu gpgpu)
+{
+  cl_int err = CL_SUCCESS;
+
+  pthread_mutex_lock(&queue->batch_lock);
+
+  if (queue->batch_max > 1 && cl_command_queue_gpgpu_batchable(gpgpu)) {
+    if (queue->batch_num == 0) {
+      queue->batch_head = queue->batch_tail = gpgpu;
+      queue->batch_num = 1;
+      goto exit;
+    }
+
+    if (cl_gpgpu_chain(queue->batch_tail, gpgpu) == 0) {
+      queue->batch_tail = gpgpu;
+      if (++queue->batch_num >= queue->batch_max)
+        err = cl_command_queue_flush_batch_locked(queue);
+      goto exit;
+    }
+
+    /* The device can not chain, never try again */
+    queue->batch_max = 1;
+  }
+
+  /* Keep the order, the batched ones go first */
+  err = cl_command_queue_flush_batch_locked(queue);
+  if (err == CL_SUCCESS)
+    err = cl_command_queue_flush_gpgpu(gpgpu);
+
+exit:
+  pthread_mutex_unlock(&queue->batch_lock);
+  return err;
+}
+
 LOCAL void
 cl_command_queue_insert_barrier_event(cl_command_queue queue, cl_event event)
 {
@@ -51,8 +51,16 @@ typedef struct _cl_command_queue {
   cl_command_queue_properties props;   /* Queue properties */
   cl_mem perf;                         /* Where to put the perf counters */
   cl_uint size;                        /* Store the specified size for queueu */
+  pthread_mutex_t batch_lock;          /* Protect the batched kernels below */
+  cl_gpgpu batch_head;                 /* First batched kernel, not flushed yet */
+  cl_gpgpu batch_tail;                 /* Last batched kernel, the others jump to the next */
+  cl_uint batch_num;                   /* Number of batched kernels */
+  cl_uint batch_max;                   /* Max kernels submitted together, 1 to disable */
 } _cl_command_queue;;
 
+/* Default of the max kernels submitted in one batch, see OCL_BATCH_NDRANGE */
+#define CL_QUEUE_BATCH_MAX 16
+
 #define CL_OBJECT_COMMAND_QUEUE_MAGIC 0x83650a12b79ce4efLL
 #define CL_OBJECT_IS_COMMAND_QUEUE(obj) ((obj &&                           \
          ((cl_base_object)obj)->magic == CL_OBJECT_COMMAND_QUEUE_MAGIC &&  \
@@ -82,12 +90,18 @@ extern cl_int cl_command_queue_ND_range(cl_command_queue queue,
 extern cl_int cl_command_queue_set_report_buffer(cl_command_queue, cl_mem);
 /* Flush for the specified gpgpu */
 extern int cl_command_queue_flush_gpgpu(cl_gpgpu);
+/* Submit the gpgpu, batched with the following ones when it is possible */
+extern cl_int cl_command_queue_submit_gpgpu(cl_command_queue, cl_gpgpu);
+/* Flush the batched gpgpus */
+extern cl_int cl_command_queue_flush_batch(cl_command_queue);
 /* Bind all the surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_surface(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all the image surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_image(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all exec info to bind table */
 extern cl_int cl_command_queue_bind_exec_info(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
+/* Record the ranges of the memory objects the kernel may access */
+extern cl_int cl_command_queue_add_busy_ranges(cl_command_queue, cl_kernel, cl_gpgpu, cl_event);
 
 /* Insert a user event to command's wait_events */
 extern void cl_command_queue_insert_event(cl_command_queue, cl_event);
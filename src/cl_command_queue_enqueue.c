@@ -31,6 +31,7 @@ worker_thread_function(void *Arg)
   cl_uint cookie = -1;
   list_node *pos;
   list_node *n;
+  list_node *done;
   list_head ready_list;
   cl_int exec_status;
 
@@ -95,6 +96,34 @@ worker_thread_function(void *Arg)
       worker->in_exec_status = CL_SUBMITTED;
       CL_OBJECT_NOTIFY_COND(queue);
       CL_OBJECT_UNLOCK(queue);
+
+      /* The host commands only wait for the GPU ones using their ranges,
+         complete them before waiting for all the GPU ones. */
+      list_for_each_safe(pos, n, &ready_list)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        if (e->exec_data.gpgpu == NULL)
+          cl_event_exec(e, CL_COMPLETE, CL_FALSE);
+      }
+    } else {
+      /* The GPU runs the kernels in order, so consecutive ones can be
+         submitted together. Any other command waits for the ones before. */
+      list_for_each_safe(pos, n, &ready_list)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        if (e->event_type == CL_COMMAND_NDRANGE_KERNEL) {
+          cl_event_exec(e, CL_SUBMITTED, CL_FALSE);
+          continue;
+        }
+
+        list_for_each(done, &ready_list)
+        {
+          if (done == pos)
+            break;
+          cl_event_exec(list_entry(done, _cl_event, enqueue_node), CL_COMPLETE, CL_FALSE);
+        }
+        cl_event_exec(e, CL_COMPLETE, CL_FALSE);
+      }
     }
 
     list_for_each_safe(pos, n, &ready_list)
@@ -274,6 +303,9 @@ cl_command_queue_wait_flush(cl_command_queue queue)
     CL_OBJECT_UNLOCK(enqueued_list[i]);
   }
 
+  /* Submitted kernels may still wait in the batch */
+  cl_command_queue_flush_batch(queue);
+
   for (i = 0; i < enqueued_num; i++) {
     cl_event_delete(enqueued_list[i]);
   }
@@ -37,9 +37,68 @@
 static INLINE size_t cl_kernel_compute_batch_sz(cl_kernel k) { return 256+256; }
 
 /* "Varing" payload is the part of the curbe that changes accross threads in the
- *  same work group. Right now, it consists in local IDs and block IPs
+ *  same work group. Right now, it consists in local IDs and block IPs. It only
+ *  depends on the work group shape, so it is built once per local size and SIMD
+ *  width as one record per thread: the three local ID arrays, the block IP array
+ *  and the thread ID
  */
 static cl_int
+cl_get_payload_template(cl_kernel ker,
+                        const size_t *local_wk_sz,
+                        size_t simd_sz,
+                        size_t thread_n,
+                        const cl_payload_template **ret)
+{
+  cl_payload_template *tpl = &ker->payload;
+  const size_t ids_sz = sizeof(uint32_t) * simd_sz;
+  const size_t local_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
+  size_t i, j, curr = 0;
+  cl_int err = CL_SUCCESS;
+
+  if (tpl->data != NULL && tpl->simd_sz == simd_sz &&
+      memcmp(tpl->local_sz, local_wk_sz, sizeof(tpl->local_sz)) == 0)
+    goto exit;
+
+  if (tpl->data)
+    cl_free(tpl->data);
+  tpl->stride = 4 * ids_sz + sizeof(uint32_t);
+  TRY_ALLOC(tpl->data, cl_malloc(thread_n * tpl->stride));
+  memcpy(tpl->local_sz, local_wk_sz, sizeof(tpl->local_sz));
+  tpl->simd_sz = simd_sz;
+  tpl->thread_n = thread_n;
+
+  for (i = 0; i < thread_n; ++i) {
+    char *rec = tpl->data + i * tpl->stride;
+    uint32_t *ids0 = (uint32_t *) rec;
+    uint32_t *ids1 = (uint32_t *) (rec + ids_sz);
+    uint32_t *ids2 = (uint32_t *) (rec + 2 * ids_sz);
+    uint32_t *ips = (uint32_t *) (rec + 3 * ids_sz);
+
+    for (j = 0; j < simd_sz; ++j, ++curr) {
+      /* 0xffff means that the lane is inactivated */
+      if (curr >= local_sz) {
+        ids0[j] = ids1[j] = ids2[j] = 0;
+        ips[j] = 0xffff;
+        continue;
+      }
+      ids0[j] = curr % local_wk_sz[0];
+      ids1[j] = (curr / local_wk_sz[0]) % local_wk_sz[1];
+      ids2[j] = curr / (local_wk_sz[0] * local_wk_sz[1]);
+      ips[j] = 0;
+    }
+    *(uint32_t *) (rec + 4 * ids_sz) = i;
+  }
+
+exit:
+  *ret = tpl;
+  return err;
+error:
+  tpl->data = NULL;
+  goto exit;
+}
+
+/* Replicate the shared curbe for every thread and patch their varying payload */
+static cl_int
 cl_set_varying_payload(const cl_kernel ker,
                        char *data,
                        const size_t *local_wk_sz,
@@ -47,90 +106,75 @@ cl_set_varying_payload(const cl_kernel ker,
                        size_t cst_sz,
                        size_t thread_n)
 {
-  uint32_t *ids[3] = {NULL,NULL,NULL};
-  uint16_t *block_ips = NULL;
-  uint32_t *thread_ids = NULL;
-  size_t i, j, k, curr = 0;
-  int32_t id_offset[3], ip_offset, tid_offset;
+  const cl_dispatch_desc *desc = &ker->dispatch;
+  /* Argument snapshots share the template of the kernel they come from */
+  cl_kernel owner = ker->parent ? ker->parent : ker;
+  const cl_payload_template *tpl = NULL;
+  const int32_t *id_offset = &desc->curbe[GBE_CURBE_LOCAL_ID_X];
+  const int32_t ip_offset = desc->curbe[GBE_CURBE_BLOCK_IP];
+  const int32_t dw_ip_offset = desc->curbe[GBE_CURBE_DW_BLOCK_IP];
+  const int32_t tid_offset = desc->curbe[GBE_CURBE_THREAD_ID];
+  const size_t ids_sz = sizeof(uint32_t) * simd_sz;
+  size_t i, j, k;
   cl_int err = CL_SUCCESS;
-  int32_t dw_ip_offset = -1;
-
-  id_offset[0] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_X, 0);
-  id_offset[1] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Y, 0);
-  id_offset[2] = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_LOCAL_ID_Z, 0);
-  ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_BLOCK_IP, 0);
-  tid_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_THREAD_ID, 0);
-  if (ip_offset < 0)
-    dw_ip_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_DW_BLOCK_IP, 0);
+
   assert(ip_offset < 0 || dw_ip_offset < 0);
   assert(ip_offset >= 0 || dw_ip_offset >= 0);
 
-  if (id_offset[0] >= 0)
-    TRY_ALLOC(ids[0], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[1] >= 0)
-    TRY_ALLOC(ids[1], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  if (id_offset[2] >= 0)
-    TRY_ALLOC(ids[2], (uint32_t*) alloca(sizeof(uint32_t)*thread_n*simd_sz));
-  TRY_ALLOC(block_ips, (uint16_t*) alloca(sizeof(uint16_t)*thread_n*simd_sz));
-  if (tid_offset >= 0) {
-    TRY_ALLOC(thread_ids, (uint32_t*) alloca(sizeof(uint32_t)*thread_n));
-    memset(thread_ids, 0, sizeof(uint32_t)*thread_n);
-  }
-  /* 0xffff means that the lane is inactivated */
-  memset(block_ips, 0xff, sizeof(int16_t)*thread_n*simd_sz);
-
-
-  /* Compute the IDs and the block IPs */
-  for (k = 0; k < local_wk_sz[2]; ++k)
-  for (j = 0; j < local_wk_sz[1]; ++j)
-  for (i = 0; i < local_wk_sz[0]; ++i, ++curr) {
-    if (id_offset[0] >= 0)
-      ids[0][curr] = i;
-    if (id_offset[1] >= 0)
-      ids[1][curr] = j;
-    if (id_offset[2] >= 0)
-      ids[2][curr] = k;
-    block_ips[curr] = 0;
-    if (thread_ids)
-      thread_ids[curr/simd_sz] = curr/simd_sz;
-  }
+  CL_OBJECT_LOCK(owner);
+  TRY (cl_get_payload_template, owner, local_wk_sz, simd_sz, thread_n, &tpl);
 
-  /* Copy them to the curbe buffer */
-  curr = 0;
   for (i = 0; i < thread_n; ++i, data += cst_sz) {
-    uint32_t *ids0 = (uint32_t *) (data + id_offset[0]);
-    uint32_t *ids1 = (uint32_t *) (data + id_offset[1]);
-    uint32_t *ids2 = (uint32_t *) (data + id_offset[2]);
-    uint16_t *ips  = (uint16_t *) (data + ip_offset);
-    uint32_t *dw_ips  = (uint32_t *) (data + dw_ip_offset);
-
-    if (thread_ids)
-      *(uint32_t *)(data + tid_offset) = thread_ids[i];
-
-    for (j = 0; j < simd_sz; ++j, ++curr) {
-      if (id_offset[0] >= 0)
-        ids0[j] = ids[0][curr];
-      if (id_offset[1] >= 0)
-        ids1[j] = ids[1][curr];
-      if (id_offset[2] >= 0)
-        ids2[j] = ids[2][curr];
-      if (ip_offset >= 0)
-        ips[j] = block_ips[curr];
-      if (dw_ip_offset >= 0)
-        dw_ips[j] = block_ips[curr];
+    const char *rec = tpl->data + i * tpl->stride;
+    memcpy(data, ker->curbe, cst_sz);
+    for (k = 0; k < 3; ++k)
+      if (id_offset[k] >= 0)
+        memcpy(data + id_offset[k], rec + k * ids_sz, ids_sz);
+    if (dw_ip_offset >= 0)
+      memcpy(data + dw_ip_offset, rec + 3 * ids_sz, ids_sz);
+    else {
+      const uint32_t *ips = (const uint32_t *) (rec + 3 * ids_sz);
+      uint16_t *dst = (uint16_t *) (data + ip_offset);
+      for (j = 0; j < simd_sz; ++j)
+        dst[j] = ips[j];
     }
+    if (tid_offset >= 0)
+      memcpy(data + tid_offset, rec + 4 * ids_sz, sizeof(uint32_t));
   }
 
 error:
+  CL_OBJECT_UNLOCK(owner);
   return err;
 }
 
+/* Gen8+ reads the head of the curbe once for all the threads and the kernel
+ * computes its local IDs: only the thread ID remains per thread */
+static void
+cl_set_cross_thread_payload(const cl_kernel ker,
+                            char *data,
+                            size_t cross_sz,
+                            size_t cst_sz,
+                            size_t thread_n)
+{
+  const int32_t tid_offset = ker->dispatch.curbe[GBE_CURBE_THREAD_ID];
+  const size_t per_thread_sz = cst_sz - cross_sz;
+  uint32_t i;
+
+  memcpy(data, ker->curbe, cross_sz);
+  data += cross_sz;
+  for (i = 0; i < thread_n; ++i, data += per_thread_sz) {
+    memcpy(data, ker->curbe + cross_sz, per_thread_sz);
+    if (tid_offset >= 0)
+      *(uint32_t *) (data + tid_offset - cross_sz) = i;
+  }
+}
+
 static int
 cl_upload_constant_buffer(cl_command_queue queue, cl_kernel ker, cl_gpgpu gpgpu)
 {
   if (interp_kernel_get_ocl_version(ker->opaque) >= 200) {
     // pass the starting of constant address space
-    int32_t constant_addrspace = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_CONSTANT_ADDRSPACE, 0);
+    int32_t constant_addrspace = ker->dispatch.curbe[GBE_CURBE_CONSTANT_ADDRSPACE];
     if (constant_addrspace >= 0) {
       size_t global_const_size = interp_program_get_global_constant_size(ker->program->opaque);
       if (global_const_size > 0) {
@@ -199,7 +243,7 @@ cl_upload_constant_buffer(cl_command_queue queue, cl_kernel ker, cl_gpgpu gpgpu)
       cl_mem mem = ker->args[arg].mem;
       uint32_t alignment = interp_kernel_get_arg_align(ker->opaque, arg);
       offset = ALIGN(offset, alignment);
-      curbe_offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_KERNEL_ARGUMENT, arg);
+      curbe_offset = ker->dispatch.arg[arg];
       if (curbe_offset < 0)
         continue;
       *(uint32_t *) (ker->curbe + curbe_offset) = offset;
@@ -227,7 +271,7 @@ cl_curbe_fill(cl_kernel ker,
 {
   int32_t offset;
 #define UPLOAD(ENUM, VALUE) \
-  if ((offset = interp_kernel_get_curbe_offset(ker->opaque, ENUM, 0)) >= 0) \
+  if ((offset = ker->dispatch.curbe[ENUM]) >= 0) \
     *((uint32_t *) (ker->curbe + offset)) = VALUE;
   UPLOAD(GBE_CURBE_LOCAL_SIZE_X, local_wk_sz[0]);
   UPLOAD(GBE_CURBE_LOCAL_SIZE_Y, local_wk_sz[1]);
@@ -259,7 +303,7 @@ cl_curbe_fill(cl_kernel ker,
     uint32_t align = interp_kernel_get_arg_align(ker->opaque, arg);
     assert(align != 0);
     slm_offset = ALIGN(slm_offset, align);
-    offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_KERNEL_ARGUMENT, arg);
+    offset = ker->dispatch.arg[arg];
     if (offset < 0)
       continue;
     uint32_t *slmptr = (uint32_t *) (ker->curbe + offset);
@@ -276,9 +320,8 @@ cl_bind_stack(cl_gpgpu gpgpu, cl_kernel ker)
   cl_context ctx = ker->program->ctx;
   cl_device_id device = ctx->devices[0];
   const int32_t per_lane_stack_sz = ker->stack_size;
-  const int32_t value = GBE_CURBE_EXTRA_ARGUMENT;
-  const int32_t sub_value = GBE_STACK_BUFFER;
-  const int32_t offset_stack_buffer = interp_kernel_get_curbe_offset(ker->opaque, value, sub_value);
+  /* The stack buffer is the GBE_STACK_BUFFER (0) extra argument */
+  const int32_t offset_stack_buffer = ker->dispatch.curbe[GBE_CURBE_EXTRA_ARGUMENT];
   int32_t stack_sz = per_lane_stack_sz;
 
   /* No stack required for this kernel */
@@ -298,7 +341,7 @@ cl_bind_stack(cl_gpgpu gpgpu, cl_kernel ker)
    */
   cl_driver_enlarge_stack_size(ctx->drv, &stack_sz);
 
-  const int32_t offset_stack_size = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_STACK_SIZE, 0);
+  const int32_t offset_stack_size = ker->dispatch.curbe[GBE_CURBE_STACK_SIZE];
   if (offset_stack_size >= 0) {
     *(uint64_t *)(ker->curbe + offset_stack_size) = stack_sz;
   }
@@ -313,7 +356,7 @@ cl_bind_profiling(cl_gpgpu gpgpu, uint32_t simd_sz, cl_kernel ker, size_t global
   int thread_num;
   if (simd_sz == 16) {
     for(i = 0; i < 3; i++) {
-      offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_PROFILING_TIMESTAMP0 + i, 0);
+      offset = ker->dispatch.curbe[GBE_CURBE_PROFILING_TIMESTAMP0 + i];
       assert(offset >= 0);
       memset(ker->curbe + offset, 0x0, sizeof(uint32_t)*8*2);
       thread_num = (local_sz + 15)/16;
@@ -321,14 +364,14 @@ cl_bind_profiling(cl_gpgpu gpgpu, uint32_t simd_sz, cl_kernel ker, size_t global
   } else {
     assert(simd_sz == 8);
     for(i = 0; i < 5; i++) {
-      offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_PROFILING_TIMESTAMP0 + i, 0);
+      offset = ker->dispatch.curbe[GBE_CURBE_PROFILING_TIMESTAMP0 + i];
       assert(offset >= 0);
       memset(ker->curbe + offset, 0x0, sizeof(uint32_t)*8);
       thread_num = (local_sz + 7)/8;
     }
   }
 
-  offset = interp_kernel_get_curbe_offset(ker->opaque, GBE_CURBE_PROFILING_BUF_POINTER, 0);
+  offset = ker->dispatch.curbe[GBE_CURBE_PROFILING_BUF_POINTER];
   thread_num = thread_num*(global_sz/local_sz);
   if (cl_gpgpu_set_profiling_buffer(gpgpu, thread_num*128 + 4, offset, bti))
     return -1;
@@ -369,8 +412,9 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   char *final_curbe = NULL;  /* Includes them and one sub-buffer per group */
   cl_gpgpu_kernel kernel;
   const uint32_t simd_sz = cl_kernel_get_simd_width(ker);
-  size_t i, batch_sz = 0u, local_sz = 0u;
+  size_t batch_sz = 0u, local_sz = 0u;
   size_t cst_sz = interp_kernel_get_curbe_size(ker->opaque);
+  size_t cross_sz = interp_kernel_get_cross_thread_curbe_size(ker->opaque);
   int32_t scratch_sz = interp_kernel_get_scratch_size(ker->opaque);
   size_t thread_n = 0u;
   int printf_num = 0;
@@ -383,6 +427,8 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
     cst_sz += ker->exec_info_n * sizeof(void *);
     cst_sz = (cst_sz + 31) / 32 * 32;   //align to register size, hard code here.
     ker->curbe = cl_realloc(ker->curbe, cst_sz);
+    /* The exec infos are appended after the per thread data */
+    cross_sz = 0;
   }
   ker->curbe_sz = cst_sz;
 
@@ -400,7 +446,8 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
     return err;
   }
   kernel.thread_n = thread_n = (local_sz + simd_sz - 1) / simd_sz;
-  kernel.curbe_sz = cst_sz;
+  kernel.curbe_sz = cst_sz - cross_sz;
+  kernel.cross_curbe_sz = cross_sz;
 
   if (scratch_sz > ker->program->ctx->devices[0]->scratch_mem_size) {
     DEBUGP(DL_ERROR, "Out of scratch memory %d.", scratch_sz);
@@ -419,7 +466,8 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   cl_gpgpu_set_printf_info(gpgpu, printf_info);
 
   /* Setup the kernel */
-  if (queue->props & CL_QUEUE_PROFILING_ENABLE)
+  /* Local size tuning launches need the execution time stamps too */
+  if ((queue->props & CL_QUEUE_PROFILING_ENABLE) || event->exec_data.tune_kernel)
     err = cl_gpgpu_state_init(gpgpu, ctx->devices[0]->max_compute_unit * ctx->devices[0]->max_thread_per_unit, cst_sz / 32, 1);
   else
     err = cl_gpgpu_state_init(gpgpu, ctx->devices[0]->max_compute_unit * ctx->devices[0]->max_thread_per_unit, cst_sz / 32, 0);
@@ -467,13 +515,18 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   /* Curbe step 2. Give the localID and upload it to video memory */
   if (ker->curbe) {
     assert(cst_sz > 0);
-    TRY_ALLOC (final_curbe, (char*) alloca(thread_n * cst_sz));
-    for (i = 0; i < thread_n; ++i) {
-        memcpy(final_curbe + cst_sz * i, ker->curbe, cst_sz);
+    if (cross_sz) {
+      const size_t curbe_sz = cross_sz + thread_n * (cst_sz - cross_sz);
+      TRY_ALLOC (final_curbe, (char*) alloca(curbe_sz));
+      cl_set_cross_thread_payload(ker, final_curbe, cross_sz, cst_sz, thread_n);
+      if (cl_gpgpu_upload_curbes(gpgpu, final_curbe, curbe_sz) != 0)
+        goto error;
+    } else {
+      TRY_ALLOC (final_curbe, (char*) alloca(thread_n * cst_sz));
+      TRY (cl_set_varying_payload, ker, final_curbe, local_wk_sz_use, simd_sz, cst_sz, thread_n);
+      if (cl_gpgpu_upload_curbes(gpgpu, final_curbe, thread_n*cst_sz) != 0)
+        goto error;
     }
-    TRY (cl_set_varying_payload, ker, final_curbe, local_wk_sz_use, simd_sz, cst_sz, thread_n);
-    if (cl_gpgpu_upload_curbes(gpgpu, final_curbe, thread_n*cst_sz) != 0)
-      goto error;
   }
 
   /* Start a new batch buffer */
@@ -493,6 +546,9 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   event->exec_data.gpgpu = gpgpu;
   event->exec_data.type = EnqueueNDRangeKernel;
 
+  if (cl_command_queue_add_busy_ranges(queue, ker, gpgpu, event) != CL_SUCCESS)
+    goto error;
+
   return CL_SUCCESS;
 
 error:
@@ -135,16 +135,61 @@ cl_context_add_event(cl_context ctx, cl_event event) {
   event->ctx = ctx;
 }
 
+/* The event must hold no reference any more. It is retired into the free
+   list of the context, or destroyed if the list is full, and must not be
+   touched after this call. */
 LOCAL void
 cl_context_remove_event(cl_context ctx, cl_event event) {
+  cl_bool recycled = CL_FALSE;
+
   assert(event->ctx == ctx);
+  event->ctx = NULL;
+
   CL_OBJECT_LOCK(ctx);
   list_node_del(&event->base.node);
   ctx->event_num--;
+  if (ctx->free_event_num < CL_CONTEXT_FREE_EVENT_MAX) {
+    CL_OBJECT_RETIRE_BASE(event);
+    list_add_tail(&ctx->free_events, &event->base.node);
+    ctx->free_event_num++;
+    recycled = CL_TRUE;
+  }
   CL_OBJECT_UNLOCK(ctx);
 
+  if (!recycled) {
+    CL_OBJECT_DESTROY_BASE(event);
+    cl_free(event);
+  }
+
   cl_context_delete(ctx);
-  event->ctx = NULL;
+}
+
+LOCAL cl_event
+cl_context_take_free_event(cl_context ctx) {
+  cl_event event = NULL;
+
+  CL_OBJECT_LOCK(ctx);
+  if (!list_empty(&ctx->free_events)) {
+    event = list_entry(ctx->free_events.head_node.n, _cl_event, base.node);
+    list_node_del(&event->base.node);
+    ctx->free_event_num--;
+  }
+  CL_OBJECT_UNLOCK(ctx);
+
+  return event;
+}
+
+static void
+cl_context_free_events(cl_context ctx) {
+  cl_event event;
+
+  while (!list_empty(&ctx->free_events)) {
+    event = list_entry(ctx->free_events.head_node.n, _cl_event, base.node);
+    list_node_del(&event->base.node);
+    CL_OBJECT_FREE_RETIRED_BASE(event);
+    cl_free(event);
+  }
+  ctx->free_event_num = 0;
 }
 
 LOCAL void
@@ -337,6 +382,7 @@ cl_context_new(struct _cl_context_prop *props, cl_uint dev_num, cl_device_id* al
   list_init(&ctx->mem_objects);
   list_init(&ctx->samplers);
   list_init(&ctx->events);
+  list_init(&ctx->free_events);
   list_init(&ctx->programs);
   ctx->queue_modify_disable = CL_FALSE;
   TRY_ALLOC_NO_ERR (ctx->drv, cl_driver_new(props));
@@ -400,6 +446,7 @@ cl_context_delete(cl_context ctx)
 
   CL_OBJECT_DEC_REF(ctx);
 
+  cl_context_free_events(ctx);
   cl_free(ctx->prop_user);
   cl_free(ctx->devices);
   cl_driver_delete(ctx->drv);
@@ -458,7 +505,7 @@ cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
       ctx->internal_kernels[index] = cl_program_create_kernel(ctx->internal_prgs[index],
                                                               "__cl_fill_region_align8_16", NULL);
     } else {
-      ctx->internal_kernels[index] = cl_kernel_dup(ctx->internal_prgs[index]->ker[0]);
+      ctx->internal_kernels[index] = cl_kernel_dup(cl_program_get_kernel(ctx->internal_prgs[index], 0, NULL));
     }
   }
   ker = ctx->internal_kernels[index];
@@ -118,6 +118,8 @@ struct _cl_context {
   cl_uint sampler_num;              /* All sampler number currently allocated */
   list_head events;                 /* All event object currently allocated */
   cl_uint event_num;                /* All event number currently allocated */
+  list_head free_events;            /* Retired events kept for reuse */
+  cl_uint free_event_num;           /* Retired events number in free_events */
   list_head programs;               /* All programs currently allocated */
   cl_uint program_num;              /* All program number currently allocated */
 
@@ -136,6 +138,9 @@ struct _cl_context {
   cl_command_queue image_queue;      /* A internal command queue for image data copying */
 };
 
+/* Max retired events kept by a context for reuse */
+#define CL_CONTEXT_FREE_EVENT_MAX 64
+
 #define CL_OBJECT_CONTEXT_MAGIC 0x20BBCADE993134AALL
 #define CL_OBJECT_IS_CONTEXT(obj) ((obj &&                           \
          ((cl_base_object)obj)->magic == CL_OBJECT_CONTEXT_MAGIC &&  \
@@ -149,6 +154,8 @@ extern void cl_context_add_sampler(cl_context ctx, cl_sampler sampler);
 extern void cl_context_remove_sampler(cl_context ctx, cl_sampler sampler);
 extern void cl_context_add_event(cl_context ctx, cl_event sampler);
 extern void cl_context_remove_event(cl_context ctx, cl_event sampler);
+/* Take a retired event for reuse, NULL if none is kept */
+extern cl_event cl_context_take_free_event(cl_context ctx);
 extern void cl_context_add_program(cl_context ctx, cl_program program);
 extern void cl_context_remove_program(cl_context ctx, cl_program program);
 
@@ -35,6 +35,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/sysinfo.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
 
 #ifndef CL_VERSION_1_2
 #define CL_DEVICE_BUILT_IN_KERNELS 0x103F
@@ -927,6 +932,42 @@ cfl_gt3_break:
   return ret;
 }
 
+/* Builds the self-test kernel from the binary generated with the library,
+ * without going through the OpenCL C front end, or from its source. */
+static cl_program
+cl_self_test_program(cl_context ctx, cl_device_id device, cl_int *status)
+{
+  extern char cl_internal_self_test_str[];
+  extern size_t cl_internal_self_test_str_size;
+  const unsigned char *binary = (const unsigned char *)cl_internal_self_test_str;
+  size_t binary_size = cl_internal_self_test_str_size;
+  const char* kernel_source = "__kernel void self_test(__global int *buf) {"
+  "  __local int tmp[3];"
+  "  tmp[get_local_id(0)] = buf[get_local_id(0)];"
+  "  barrier(CLK_LOCAL_MEM_FENCE);"
+  "  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];"
+  "}"; // using __local to catch the "no SLM on Haswell" problem
+  cl_program program;
+
+  program = clCreateProgramWithBinary(ctx, 1, &device, &binary_size, &binary, NULL, status);
+  if (*status == CL_SUCCESS) {
+    *status = clBuildProgram(program, 1, &device, "", NULL, NULL);
+    if (*status == CL_SUCCESS)
+      return program;
+    clReleaseProgram(program);
+  }
+
+  program = clCreateProgramWithSource(ctx, 1, &kernel_source, NULL, status);
+  if (*status != CL_SUCCESS)
+    return NULL;
+  *status = clBuildProgram(program, 1, &device, "", NULL, NULL);
+  if (*status != CL_SUCCESS) {
+    clReleaseProgram(program);
+    return NULL;
+  }
+  return program;
+}
+
 /* Runs a small kernel to check that the device works; returns
  * SELF_TEST_PASS: for success.
  * SELF_TEST_SLM_FAIL: for SLM results mismatch;
@@ -944,12 +985,6 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   cl_event kernel_finished;
   size_t n = 3;
   cl_int test_data[3] = {3, 7, 5};
-  const char* kernel_source = "__kernel void self_test(__global int *buf) {"
-  "  __local int tmp[3];"
-  "  tmp[get_local_id(0)] = buf[get_local_id(0)];"
-  "  barrier(CLK_LOCAL_MEM_FENCE);"
-  "  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];"
-  "}"; // using __local to catch the "no SLM on Haswell" problem
   static int tested = 0;
   static cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
   if (tested != 0)
@@ -962,42 +997,39 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   if (status == CL_SUCCESS) {
     queue = clCreateCommandQueueWithProperties(ctx, device, 0, &status);
     if (status == CL_SUCCESS) {
-      program = clCreateProgramWithSource(ctx, 1, &kernel_source, NULL, &status);
-      if (status == CL_SUCCESS) {
-        status = clBuildProgram(program, 1, &device, "", NULL, NULL);
+      program = cl_self_test_program(ctx, device, &status);
+      if (program) {
+        kernel = clCreateKernel(program, "self_test", &status);
         if (status == CL_SUCCESS) {
-          kernel = clCreateKernel(program, "self_test", &status);
+          buffer = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, n*4, test_data, &status);
           if (status == CL_SUCCESS) {
-            buffer = clCreateBuffer(ctx, CL_MEM_COPY_HOST_PTR, n*4, test_data, &status);
+            status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
             if (status == CL_SUCCESS) {
-              status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+              status = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &n, &n, 0, NULL, &kernel_finished);
               if (status == CL_SUCCESS) {
-                status = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &n, &n, 0, NULL, &kernel_finished);
+                status = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, n*4, test_data, 1, &kernel_finished, NULL);
                 if (status == CL_SUCCESS) {
-                  status = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, n*4, test_data, 1, &kernel_finished, NULL);
-                  if (status == CL_SUCCESS) {
-                    if (test_data[0] == 8 && test_data[1] == 14 && test_data[2] == 8){
-                      ret = SELF_TEST_PASS;
-                    } else {
-                      ret = SELF_TEST_SLM_FAIL;
-                      printf("Beignet: self-test failed: (3, 7, 5) + (5, 7, 3) returned (%i, %i, %i)\n"
-                             "See README.md or http://www.freedesktop.org/wiki/Software/Beignet/\n",
-                             test_data[0], test_data[1], test_data[2]);
-
-                    }
+                  if (test_data[0] == 8 && test_data[1] == 14 && test_data[2] == 8){
+                    ret = SELF_TEST_PASS;
+                  } else {
+                    ret = SELF_TEST_SLM_FAIL;
+                    printf("Beignet: self-test failed: (3, 7, 5) + (5, 7, 3) returned (%i, %i, %i)\n"
+                           "See README.md or http://www.freedesktop.org/wiki/Software/Beignet/\n",
+                           test_data[0], test_data[1], test_data[2]);
+
                   }
-                } else{
-                  ret = SELF_TEST_ATOMIC_FAIL;
-                  // Atomic fail need to test SLM again with atomic in L3 feature disabled.
-                  tested = 0;
                 }
-                clReleaseEvent(kernel_finished);
+              } else{
+                ret = SELF_TEST_ATOMIC_FAIL;
+                // Atomic fail need to test SLM again with atomic in L3 feature disabled.
+                tested = 0;
               }
+              clReleaseEvent(kernel_finished);
             }
-            clReleaseMemObject(buffer);
           }
-          clReleaseKernel(kernel);
+          clReleaseMemObject(buffer);
         }
+        clReleaseKernel(kernel);
       }
       clReleaseProgram(program);
     }
@@ -1007,6 +1039,112 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   return ret;
 }
 
+/* The self-test verdict only depends on the device, the kernel driver and
+ * this library. It is kept in $XDG_CACHE_HOME/beignet (~/.cache/beignet by
+ * default), unless OCL_SELF_TEST_CACHE=0. */
+static int
+cl_self_test_cache_path(cl_device_id device, char *path, size_t path_sz, char *key, size_t key_sz)
+{
+  const char *env = getenv("OCL_SELF_TEST_CACHE");
+  const char *dir = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  struct utsname kernel;
+  int n;
+
+  if (env != NULL && strcmp(env, "0") == 0)
+    return -1;
+  if (uname(&kernel) != 0)
+    return -1;
+
+  if (dir != NULL && dir[0] != '\0')
+    n = snprintf(path, path_sz, "%s/beignet", dir);
+  else if (home != NULL && home[0] != '\0')
+    n = snprintf(path, path_sz, "%s/.cache/beignet", home);
+  else
+    return -1;
+  if (n < 0 || (size_t)n >= path_sz)
+    return -1;
+  n += snprintf(path + n, path_sz - n, "/self-test-%04x", device->device_id);
+  if ((size_t)n >= path_sz)
+    return -1;
+
+  n = snprintf(key, key_sz, "%s %s beignet %s%s", kernel.release, kernel.version,
+               LIBCL_DRIVER_VERSION_STRING, BEIGNET_GIT_SHA1_STRING);
+  if (n < 0 || (size_t)n >= key_sz)
+    return -1;
+  return 0;
+}
+
+static int
+cl_self_test_cache_load(cl_device_id device, cl_self_test_res *res)
+{
+  static int loaded = 0;
+  static cl_self_test_res loaded_res;
+  static uint32_t loaded_atomic;
+  char path[PATH_MAX], key[512], line[512];
+  unsigned int cached_res, cached_atomic;
+  FILE *file;
+  int err = -1;
+
+  if (loaded) {
+    *res = loaded_res;
+    device->atomic_test_result = loaded_atomic;
+    return 0;
+  }
+
+  if (cl_self_test_cache_path(device, path, sizeof(path), key, sizeof(key)) != 0)
+    return -1;
+  if ((file = fopen(path, "r")) == NULL)
+    return -1;
+
+  if (fgets(line, sizeof(line), file) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if (strcmp(line, key) == 0 &&
+        fscanf(file, "%u %u", &cached_res, &cached_atomic) == 2 &&
+        cached_res < SELF_TEST_OTHER_FAIL) {
+      loaded = 1;
+      loaded_res = *res = cached_res;
+      loaded_atomic = device->atomic_test_result = cached_atomic;
+      err = 0;
+    }
+  }
+  fclose(file);
+  return err;
+}
+
+/* Written to a temporary file and renamed, concurrent processes may race */
+static void
+cl_self_test_cache_store(cl_device_id device, cl_self_test_res res)
+{
+  char path[PATH_MAX], tmp_path[PATH_MAX + 32], key[512];
+  char *slash;
+  FILE *file;
+
+  /* A failure to run the test may be transient, test again next time */
+  if (res == SELF_TEST_OTHER_FAIL)
+    return;
+  if (cl_self_test_cache_path(device, path, sizeof(path), key, sizeof(key)) != 0)
+    return;
+
+  slash = strrchr(path, '/');
+  *slash = '\0';
+  if (mkdir(path, 0755) != 0 && errno == ENOENT) {
+    char *parent = strrchr(path, '/');
+    *parent = '\0';
+    mkdir(path, 0755);
+    *parent = '/';
+    mkdir(path, 0755);
+  }
+  *slash = '/';
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+  if ((file = fopen(tmp_path, "w")) == NULL)
+    return;
+  fprintf(file, "%s\n%u %u\n", key, (unsigned int)res, (unsigned int)device->atomic_test_result);
+  if (fclose(file) != 0 || rename(tmp_path, path) != 0)
+    unlink(tmp_path);
+}
+
 LOCAL cl_int
 cl_get_device_ids(cl_platform_id    platform,
                   cl_device_type    device_type,
@@ -1019,11 +1157,15 @@ cl_get_device_ids(cl_platform_id    platform,
   /* Do we have a usable device? */
   device = cl_get_gt_device(device_type);
   if (device) {
-    cl_self_test_res ret = cl_self_test(device, SELF_TEST_PASS);
-    if (ret == SELF_TEST_ATOMIC_FAIL) {
-      device->atomic_test_result = ret;
-      ret = cl_self_test(device, ret);
-      printf("Beignet: warning - disable atomic in L3 feature.\n");
+    cl_self_test_res ret;
+    if (cl_self_test_cache_load(device, &ret) != 0) {
+      ret = cl_self_test(device, SELF_TEST_PASS);
+      if (ret == SELF_TEST_ATOMIC_FAIL) {
+        device->atomic_test_result = ret;
+        ret = cl_self_test(device, ret);
+        printf("Beignet: warning - disable atomic in L3 feature.\n");
+      }
+      cl_self_test_cache_store(device, ret);
     }
 
     if(ret == SELF_TEST_SLM_FAIL) {
@@ -123,7 +123,8 @@ typedef enum gpu_command_status {
 typedef struct cl_gpgpu_kernel {
   const char *name;        /* kernel name and bo name */
   uint32_t grf_blocks;     /* register blocks kernel wants (in 8 reg blocks) */
-  uint32_t curbe_sz;       /* total size of all curbes */
+  uint32_t curbe_sz;       /* size of the curbe of one thread */
+  uint32_t cross_curbe_sz; /* size of the curbe shared by all threads (gen8+) */
   cl_buffer bo;            /* kernel code in the proper addr space */
   int32_t barrierID;       /* barrierID for _this_ kernel */
   uint32_t use_slm:1;      /* For gen7 (automatic barrier management) */
@@ -247,6 +248,11 @@ extern cl_gpgpu_batch_end_cb *cl_gpgpu_batch_end;
 typedef int (cl_gpgpu_flush_cb)(cl_gpgpu);
 extern cl_gpgpu_flush_cb *cl_gpgpu_flush;
 
+/* Make the command buffer jump into the one of next when it ends, flushing
+ * it then submits both. Return -1 if the device can not chain them */
+typedef int (cl_gpgpu_chain_cb)(cl_gpgpu, cl_gpgpu next);
+extern cl_gpgpu_chain_cb *cl_gpgpu_chain;
+
 /* new a event for a batch buffer */
 typedef cl_gpgpu_event (cl_gpgpu_event_new_cb)(cl_gpgpu);
 extern cl_gpgpu_event_new_cb *cl_gpgpu_event_new;
@@ -431,6 +437,10 @@ extern cl_buffer_get_subdata_cb *cl_buffer_get_subdata;
 typedef int (cl_buffer_wait_rendering_cb) (cl_buffer);
 extern cl_buffer_wait_rendering_cb *cl_buffer_wait_rendering;
 
+/* Whether some rendering for this buffer is still pending */
+typedef int (cl_buffer_is_busy_cb) (cl_buffer);
+extern cl_buffer_is_busy_cb *cl_buffer_is_busy;
+
 typedef int (cl_buffer_get_fd_cb)(cl_buffer, int *fd);
 extern cl_buffer_get_fd_cb *cl_buffer_get_fd;
 
@@ -25,11 +25,21 @@
 #include "cl_utils.h"
 #include "cl_alloc.h"
 #include "cl_device_enqueue.h"
+#include "cl_kernel.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
 
+/* Offset and size of the bytes of a buffer covered by a rectangle */
+static size_t
+cl_enqueue_rect_range(const size_t *origin, const size_t *region,
+                      size_t row_pitch, size_t slice_pitch, size_t *offset)
+{
+  *offset = origin[0] + row_pitch * origin[1] + slice_pitch * origin[2];
+  return (region[2] - 1) * slice_pitch + (region[1] - 1) * row_pitch + region[0];
+}
+
 static cl_int
 cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
 {
@@ -50,7 +60,8 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
                               data->size, data->ptr) != 0)
       err = CL_MAP_FAILURE;
   } else {
-    void *src_ptr = cl_mem_map_auto(mem, 0);
+    cl_bool gtt;
+    void *src_ptr = cl_mem_map_range(mem, data->offset, data->size, 0, &gtt);
     if (src_ptr == NULL)
       err = CL_MAP_FAILURE;
     else {
@@ -58,7 +69,7 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
       //memcpy is not necessary for this case
       if (data->ptr != (char *)src_ptr + data->offset + buffer->sub_offset)
         memcpy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size);
-      cl_mem_unmap_auto(mem);
+      cl_mem_unmap_range(mem, gtt);
     }
   }
   return err;
@@ -70,6 +81,7 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
   cl_int err = CL_SUCCESS;
   void *src_ptr;
   void *dst_ptr;
+  cl_bool gtt;
 
   const size_t *origin = data->origin;
   const size_t *host_origin = data->host_origin;
@@ -83,13 +95,14 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
   assert(mem->type == CL_MEM_BUFFER_TYPE ||
          mem->type == CL_MEM_SUBBUFFER_TYPE);
   struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
+  size_t offset;
+  size_t size = cl_enqueue_rect_range(origin, region, data->row_pitch, data->slice_pitch, &offset);
 
-  if (!(src_ptr = cl_mem_map_auto(mem, 0))) {
+  if (!(src_ptr = cl_mem_map_range(mem, offset, size, 0, &gtt))) {
     err = CL_MAP_FAILURE;
     goto error;
   }
 
-  size_t offset = origin[0] + data->row_pitch * origin[1] + data->slice_pitch * origin[2];
   src_ptr = (char *)src_ptr + offset + buffer->sub_offset;
 
   offset = host_origin[0] + data->host_row_pitch * host_origin[1] + data->host_slice_pitch * host_origin[2];
@@ -113,7 +126,7 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
     }
   }
 
-  err = cl_mem_unmap_auto(mem);
+  err = cl_mem_unmap_range(mem, gtt);
 
 error:
   return err;
@@ -127,21 +140,32 @@ cl_enqueue_write_buffer(enqueue_data *data, cl_int status)
   assert(mem->type == CL_MEM_BUFFER_TYPE ||
          mem->type == CL_MEM_SUBBUFFER_TYPE);
   struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
+  cl_bool gtt;
 
   if (status != CL_COMPLETE)
     return err;
 
   if (mem->is_userptr) {
-    void *dst_ptr = cl_mem_map_auto(mem, 1);
+    void *dst_ptr = cl_mem_map_range(mem, data->offset, data->size, 1, &gtt);
     if (dst_ptr == NULL)
       err = CL_MAP_FAILURE;
     else {
       memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
-      cl_mem_unmap_auto(mem);
+      cl_mem_unmap_range(mem, gtt);
     }
   } else {
-    if (cl_buffer_subdata(mem->bo, data->offset + buffer->sub_offset,
-                          data->size, data->const_ptr) != 0)
+    /* pwrite would wait for all the commands using the bo */
+    cl_mem_wait_range(mem, data->offset, data->size, 1);
+    if (cl_buffer_is_busy(mem->bo)) {
+      void *dst_ptr = cl_mem_map_range(mem, data->offset, data->size, 1, &gtt);
+      if (dst_ptr == NULL)
+        err = CL_MAP_FAILURE;
+      else {
+        memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
+        cl_mem_unmap_range(mem, gtt);
+      }
+    } else if (cl_buffer_subdata(mem->bo, data->offset + buffer->sub_offset,
+                                 data->size, data->const_ptr) != 0)
       err = CL_MAP_FAILURE;
   }
 
@@ -163,16 +187,18 @@ cl_enqueue_write_buffer_rect(enqueue_data *data, cl_int status)
   assert(mem->type == CL_MEM_BUFFER_TYPE ||
          mem->type == CL_MEM_SUBBUFFER_TYPE);
   struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
+  size_t offset;
+  size_t size = cl_enqueue_rect_range(origin, region, data->row_pitch, data->slice_pitch, &offset);
+  cl_bool gtt;
 
   if (status != CL_COMPLETE)
     return err;
 
-  if (!(dst_ptr = cl_mem_map_auto(mem, 1))) {
+  if (!(dst_ptr = cl_mem_map_range(mem, offset, size, 1, &gtt))) {
     err = CL_MAP_FAILURE;
     goto error;
   }
 
-  size_t offset = origin[0] + data->row_pitch * origin[1] + data->slice_pitch * origin[2];
   dst_ptr = (char *)dst_ptr + offset + buffer->sub_offset;
 
   offset = host_origin[0] + data->host_row_pitch * host_origin[1] + data->host_slice_pitch * host_origin[2];
@@ -196,7 +222,7 @@ cl_enqueue_write_buffer_rect(enqueue_data *data, cl_int status)
     }
   }
 
-  err = cl_mem_unmap_auto(mem);
+  err = cl_mem_unmap_range(mem, gtt);
 
 error:
   return err;
@@ -286,6 +312,7 @@ cl_enqueue_map_buffer(enqueue_data *data, cl_int status)
          mem->type == CL_MEM_SUBBUFFER_TYPE ||
          mem->type == CL_MEM_SVM_TYPE);
   struct _cl_mem_buffer* buffer = (struct _cl_mem_buffer *)mem;
+  cl_bool gtt;
 
   if (status == CL_SUBMITTED) {
     if (buffer->base.is_userptr) {
@@ -295,17 +322,21 @@ cl_enqueue_map_buffer(enqueue_data *data, cl_int status)
         err = CL_MAP_FAILURE;
         return err;
       }
+      data->gtt_map = 1;
     }
     data->ptr = ptr;
   } else if (status == CL_COMPLETE) {
-    if (mem->is_userptr)
-      ptr = cl_mem_map_auto(mem, data->write_map ? 1 : 0);
-    else {
-      if (data->unsync_map == 1)
-        //because using unsync map in clEnqueueMapBuffer, so force use map_gtt here
-        ptr = cl_mem_map_gtt(mem);
-      else
-        ptr = cl_mem_map_auto(mem, data->write_map ? 1 : 0);
+    if (data->ptr) {
+      /* Already mapped and returned at submission, only wait for the range */
+      cl_mem_wait_range(mem, data->offset, data->size, data->write_map ? 1 : 0);
+      ptr = data->ptr;
+    } else if (!mem->is_userptr && data->unsync_map == 1) {
+      //because using unsync map in clEnqueueMapBuffer, so force use map_gtt here
+      ptr = cl_mem_map_gtt(mem);
+      data->gtt_map = 1;
+    } else {
+      ptr = cl_mem_map_range(mem, data->offset, data->size, data->write_map ? 1 : 0, &gtt);
+      data->gtt_map = gtt;
     }
 
     if (ptr == NULL) {
@@ -314,7 +345,8 @@ cl_enqueue_map_buffer(enqueue_data *data, cl_int status)
     }
     data->ptr = ptr;
 
-    if ((mem->flags & CL_MEM_USE_HOST_PTR) && !mem->is_userptr) {
+    /* The host will overwrite an invalidated region, no need to read it back */
+    if ((mem->flags & CL_MEM_USE_HOST_PTR) && !mem->is_userptr && !data->invalidate_map) {
       assert(mem->host_ptr);
       ptr = (char *)ptr + data->offset + buffer->sub_offset;
       memcpy(mem->host_ptr + data->offset + buffer->sub_offset, ptr, data->size);
@@ -339,12 +371,16 @@ cl_enqueue_map_image(enqueue_data *data, cl_int status)
       goto error;
     }
     data->ptr = ptr;
+    data->gtt_map = 1;
   } else if (status == CL_COMPLETE) {
-    if (data->unsync_map == 1)
+    if (data->unsync_map == 1) {
       //because using unsync map in clEnqueueMapBuffer, so force use map_gtt here
       ptr = cl_mem_map_gtt(mem);
-    else
+      data->gtt_map = 1;
+    } else {
       ptr = cl_mem_map_auto(mem, data->write_map ? 1 : 0);
+      data->gtt_map = 0;
+    }
 
     if (ptr == NULL) {
       err = CL_MAP_FAILURE;
@@ -382,6 +418,7 @@ cl_enqueue_unmap_mem_object(enqueue_data *data, cl_int status)
   void *mapped_ptr = data->ptr;
   cl_mem memobj = data->mem_obj;
   size_t row_pitch = 0;
+  uint8_t gtt_map = 0;
 
   if (status != CL_COMPLETE)
     return err;
@@ -393,6 +430,7 @@ cl_enqueue_unmap_mem_object(enqueue_data *data, cl_int status)
       memobj->mapped_ptr[i].ptr = NULL;
       mapped_size = memobj->mapped_ptr[i].size;
       v_ptr = memobj->mapped_ptr[i].v_ptr;
+      gtt_map = memobj->mapped_ptr[i].gtt_map;
       for (j = 0; j < 3; j++) {
         region[j] = memobj->mapped_ptr[i].region[j];
         origin[j] = memobj->mapped_ptr[i].origin[j];
@@ -401,6 +439,7 @@ cl_enqueue_unmap_mem_object(enqueue_data *data, cl_int status)
       }
       memobj->mapped_ptr[i].size = 0;
       memobj->mapped_ptr[i].v_ptr = NULL;
+      memobj->mapped_ptr[i].gtt_map = 0;
       memobj->map_ref--;
       break;
     }
@@ -434,7 +473,7 @@ cl_enqueue_unmap_mem_object(enqueue_data *data, cl_int status)
     assert(v_ptr == mapped_ptr);
   }
 
-  cl_mem_unmap_auto(memobj);
+  cl_mem_unmap_range(memobj, gtt_map);
 
   /* shrink the mapped slot. */
   if (memobj->mapped_ptr_sz / 2 > memobj->map_ref) {
@@ -562,13 +601,30 @@ cl_int cl_enqueue_svm_mem_fill(enqueue_data *data, cl_int status) {
   return CL_SUCCESS;
 }
 
+static void
+cl_enqueue_release_busy_ranges(enqueue_data *data)
+{
+  cl_uint i;
+
+  if (data->busy_mems == NULL)
+    return;
+
+  for (i = 0; i < data->busy_mem_n; i++) {
+    cl_mem_remove_busy_ranges(data->busy_mems[i], data->gpgpu);
+    cl_mem_delete(data->busy_mems[i]);
+  }
+  cl_free(data->busy_mems);
+  data->busy_mems = NULL;
+  data->busy_mem_n = 0;
+}
+
 static cl_int
 cl_enqueue_ndrange(enqueue_data *data, cl_int status)
 {
   cl_int err = CL_SUCCESS;
 
   if (status == CL_SUBMITTED) {
-    err = cl_command_queue_flush_gpgpu(data->gpgpu);
+    err = cl_command_queue_submit_gpgpu(data->queue, data->gpgpu);
     //if it is the last ndrange of an cl enqueue api,
     //check the device enqueue information.
     if (data->mid_event_of_enq == 0) {
@@ -576,9 +632,25 @@ cl_enqueue_ndrange(enqueue_data *data, cl_int status)
       cl_device_enqueue_parse_result(data->queue, data->gpgpu);
     }
   } else if (status == CL_COMPLETE) {
+    /* The batch may still hold this gpgpu */
+    err = cl_command_queue_flush_batch(data->queue);
+    if (err != CL_SUCCESS)
+      return err;
+
     void *batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
     cl_gpgpu_sync(batch_buf);
     cl_gpgpu_unref_batch_buf(batch_buf);
+    cl_enqueue_release_busy_ranges(data);
+
+    if (data->tune_kernel) {
+      uint64_t start = 0, end = 0;
+      cl_gpgpu_event_get_exec_timestamp(data->gpgpu, 0, &start);
+      cl_gpgpu_event_get_exec_timestamp(data->gpgpu, 1, &end);
+      cl_kernel_tune_report(data->tune_kernel, data->tune_slot,
+                            end >= start ? end - start : CL_ULONG_MAX);
+      cl_kernel_delete(data->tune_kernel);
+      data->tune_kernel = NULL;
+    }
   }
 
   return err;
@@ -596,6 +668,18 @@ cl_enqueue_delete(enqueue_data *data)
   if (data == NULL)
     return;
 
+  /* Set before the NDRange is built, released whatever step it failed at */
+  if (data->kernel) {
+    cl_kernel_delete(data->kernel);
+    data->kernel = NULL;
+  }
+  if (data->tune_kernel) {
+    /* The launch never ran, count it untimed so that the tuning can end */
+    cl_kernel_tune_report(data->tune_kernel, data->tune_slot, CL_ULONG_MAX);
+    cl_kernel_delete(data->tune_kernel);
+    data->tune_kernel = NULL;
+  }
+
   if (data->type == EnqueueCopyBufferRect ||
       data->type == EnqueueCopyBuffer ||
       data->type == EnqueueCopyImage ||
@@ -604,6 +688,7 @@ cl_enqueue_delete(enqueue_data *data)
       data->type == EnqueueNDRangeKernel ||
       data->type == EnqueueFillBuffer ||
       data->type == EnqueueFillImage) {
+    cl_enqueue_release_busy_ranges(data);
     if (data->gpgpu) {
       cl_gpgpu_delete(data->gpgpu);
       data->gpgpu = NULL;
@@ -69,7 +69,9 @@ typedef struct _enqueue_data {
   void *ptr;                 /* Ptr for write and return value */
   const cl_mem *mem_list;    /* mem_list of clEnqueueNativeKernel */
   uint8_t unsync_map;        /* Indicate the clEnqueueMapBuffer/Image is unsync map */
+  uint8_t gtt_map;           /* Indicate the returned pointer is a GTT map */
   uint8_t write_map;         /* Indicate if the clEnqueueMapBuffer is write enable */
+  uint8_t invalidate_map;    /* Indicate the mapped region is write invalidated */
   void ** pointers;          /* The svm_pointers of clEnqueueSVMFree  */
   size_t  pattern_size;      /* the pattern_size of clEnqueueSVMMemFill */
   void (*user_func)(void *); /* pointer to a host-callable user function */
@@ -78,6 +80,11 @@ typedef struct _enqueue_data {
                                  void *svm_pointers[],
                                  void *user_data);  /* pointer to pfn_free_func of clEnqueueSVMFree */
   cl_gpgpu gpgpu;
+  cl_kernel kernel;          /* Argument snapshot the NDRange was built from */
+  cl_kernel tune_kernel;     /* Kernel whose local size this launch is tuning */
+  cl_int tune_slot;          /* Tuning slot to report the run time to */
+  cl_mem *busy_mems;         /* Bo owners with a busy range of this NDRange */
+  cl_uint busy_mem_n;        /* Number of busy_mems */
   cl_bool mid_event_of_enq;  /* For non-uniform ndrange, one enqueue have a sequence event, the
                                 last event need to parse device enqueue information.
                                 0 : last event; 1: non-last event */
@@ -22,6 +22,24 @@
 #include "cl_alloc.h"
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* Event completions bump this counter. A thread waiting for a list of events
+   sleeps on it, so any of them completing wakes it up once */
+static atomic_t cl_event_complete_seq = 0;
+static atomic_t cl_event_sleeper_n = 0;
+
+static void
+cl_event_wake_waiters(void)
+{
+  atomic_inc(&cl_event_complete_seq);
+  if (atomic_read(&cl_event_sleeper_n) > 0)
+    syscall(SYS_futex, &cl_event_complete_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
 
 // TODO: Need to move it to some device related file later.
 static void
@@ -149,11 +167,18 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
              cl_uint num_events, cl_event *event_list)
 {
   int i;
-  cl_event e = cl_calloc(1, sizeof(_cl_event));
-  if (e == NULL)
-    return NULL;
+  cl_event e = cl_context_take_free_event(ctx);
+  if (e) {
+    /* Keep the sync objects of the base, clear all the rest. */
+    memset((char *)e + sizeof(_cl_base_object), 0, sizeof(_cl_event) - sizeof(_cl_base_object));
+    CL_OBJECT_REVIVE_BASE(e, CL_OBJECT_EVENT_MAGIC);
+  } else {
+    e = cl_calloc(1, sizeof(_cl_event));
+    if (e == NULL)
+      return NULL;
 
-  CL_OBJECT_INIT_BASE(e, CL_OBJECT_EVENT_MAGIC);
+    CL_OBJECT_INIT_BASE(e, CL_OBJECT_EVENT_MAGIC);
+  }
 
   /* Append the event in the context event list */
   cl_context_add_event(ctx, e);
@@ -174,6 +199,11 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
     assert(queue == NULL);
   }
 
+  /* Small lists are built on the stack of cl_event_create, copy them. */
+  if (event_list && num_events <= CL_EVENT_INLINE_DEPEND_N) {
+    memcpy(e->inline_depends, event_list, num_events * sizeof(cl_event));
+    event_list = e->inline_depends;
+  }
   e->depend_events = event_list;
   e->depend_event_num = num_events;
   for (i = 0; i < 4; i++) {
@@ -198,7 +228,8 @@ cl_event_delete_depslist(cl_event event)
     for (int i = 0; i < depend_count; i++) {
       cl_event_delete(old_depend_events[i]);
     }
-    cl_free(old_depend_events);
+    if (old_depend_events != event->inline_depends)
+      cl_free(old_depend_events);
   }
 }
 
@@ -227,12 +258,9 @@ cl_event_delete(cl_event event)
     cl_free(cb);
   }
 
-  /* Remove it from the list */
+  /* Remove it from the list, the context keeps or frees it. */
   assert(event->ctx);
   cl_context_remove_event(event->ctx, event);
-
-  CL_OBJECT_DESTROY_BASE(event);
-  cl_free(event);
 }
 
 LOCAL cl_event
@@ -241,6 +269,7 @@ cl_event_create(cl_context ctx, cl_command_queue queue, cl_uint num_events,
 {
   cl_event e = NULL;
   cl_event *depend_events = NULL;
+  cl_event small_depends[CL_EVENT_INLINE_DEPEND_N];
   cl_int err = CL_SUCCESS;
   cl_uint total_events = 0;
   int i;
@@ -265,7 +294,9 @@ cl_event_create(cl_context ctx, cl_command_queue queue, cl_uint num_events,
       CL_OBJECT_LOCK(queue);
       total_events = queue->barrier_events_num + num_events;
 
-      if (total_events) {
+      if (total_events && total_events <= CL_EVENT_INLINE_DEPEND_N) {
+        depend_events = small_depends;
+      } else if (total_events) {
         depend_events = cl_calloc(total_events, sizeof(cl_event));
         if (depend_events == NULL) {
           CL_OBJECT_UNLOCK(queue);
@@ -308,7 +339,8 @@ cl_event_create(cl_context ctx, cl_command_queue queue, cl_uint num_events,
       for (i = 0; i < total_events; i++) {
         cl_event_delete(depend_events[i]);
       }
-      cl_free(depend_events);
+      if (depend_events != small_depends)
+        cl_free(depend_events);
     }
 
     // if set depend_events, must succeed.
@@ -439,6 +471,9 @@ cl_event_set_status(cl_event event, cl_int status)
 
   CL_OBJECT_UNLOCK(event);
 
+  if (notify_queue)
+    cl_event_wake_waiters();
+
   /* Need to notify all the command queue within the same context. */
   if (notify_queue) {
     cl_command_queue queue = NULL;
@@ -479,29 +514,89 @@ cl_event_wait_for_event_ready(const cl_event event)
   return cl_event_wait_for_events_list(event->depend_event_num, event->depend_events);
 }
 
+/* How long the waiter spins before it goes to sleep, in nano seconds */
+#define CL_EVENT_SPIN_NS 5000
+
+static INLINE uint64_t
+cl_event_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static INLINE cl_int
+cl_event_peek_status(cl_event e)
+{
+  return *(volatile cl_int *)&e->status;
+}
+
+/* Wait for the GPU to finish the batch of the last submitted command of the
+   list, rather than for the queue worker to tell us */
+static void
+cl_event_wait_last_batch(cl_uint num_events, const cl_event *event_list)
+{
+  void *batch = NULL;
+  cl_event e;
+  int i;
+
+  for (i = num_events - 1; i >= 0 && batch == NULL; i--) {
+    e = event_list[i];
+    if (cl_event_peek_status(e) <= CL_COMPLETE)
+      continue;
+    CL_OBJECT_LOCK(e);
+    if (e->status > CL_COMPLETE && e->status <= CL_SUBMITTED && e->exec_data.gpgpu)
+      batch = cl_gpgpu_ref_batch_buf(e->exec_data.gpgpu);
+    CL_OBJECT_UNLOCK(e);
+  }
+
+  if (batch) {
+    cl_gpgpu_sync(batch);
+    cl_gpgpu_unref_batch_buf(batch);
+  }
+}
+
 LOCAL cl_int
 cl_event_wait_for_events_list(cl_uint num_events, const cl_event *event_list)
 {
-  int i;
-  cl_event e;
+  cl_uint i, first = 0;
+  uint64_t spin_end = 0;
+  cl_bool batch_waited = CL_FALSE;
   cl_int ret = CL_SUCCESS;
+  int seq;
 
   for (i = 0; i < num_events; i++) {
-    e = event_list[i];
-    assert(e);
-    assert(CL_OBJECT_IS_EVENT(e));
+    assert(event_list[i]);
+    assert(CL_OBJECT_IS_EVENT(event_list[i]));
+  }
 
-    CL_OBJECT_LOCK(e);
-    while (e->status > CL_COMPLETE) {
-      CL_OBJECT_WAIT_ON_COND(e);
+  while (1) {
+    /* Read the counter first, a completion after it changes it and we will
+       not sleep */
+    seq = atomic_read(&cl_event_complete_seq);
+    while (first < num_events && cl_event_peek_status(event_list[first]) <= CL_COMPLETE)
+      first++;
+    if (first == num_events)
+      break;
+
+    if (spin_end == 0)
+      spin_end = cl_event_now_ns() + CL_EVENT_SPIN_NS;
+    if (cl_event_now_ns() < spin_end) {
+      cpu_relax();
+    } else if (!batch_waited) {
+      batch_waited = CL_TRUE;
+      cl_event_wait_last_batch(num_events - first, event_list + first);
+    } else {
+      atomic_inc(&cl_event_sleeper_n);
+      syscall(SYS_futex, &cl_event_complete_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+      atomic_dec(&cl_event_sleeper_n);
     }
+  }
 
-    assert(e->status <= CL_COMPLETE);
+  for (i = 0; i < num_events; i++) {
     /* Iff some error happened, return the error. */
-    if (e->status < CL_COMPLETE) {
+    if (cl_event_peek_status(event_list[i]) < CL_COMPLETE)
       ret = CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
-    }
-    CL_OBJECT_UNLOCK(e);
   }
 
   return ret;
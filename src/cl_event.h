@@ -37,6 +37,9 @@ typedef struct _cl_event_user_callback {
 
 typedef _cl_event_user_callback *cl_event_user_callback;
 
+/* Depend lists up to this size are kept inside the event itself */
+#define CL_EVENT_INLINE_DEPEND_N 4
+
 typedef struct _cl_event {
   _cl_base_object base;
   cl_context ctx;             /* The context associated with event */
@@ -50,6 +53,7 @@ typedef struct _cl_event {
   list_node enqueue_node;     /* The node in the enqueue list. */
   cl_ulong timestamp[5];      /* The time stamps for profiling. */
   enqueue_data exec_data; /* Context for execute this event. */
+  cl_event inline_depends[CL_EVENT_INLINE_DEPEND_N]; /* Storage of small depend lists. */
 } _cl_event;
 
 #define CL_OBJECT_EVENT_MAGIC 0x8324a9f810ebf90fLL
@@ -45,6 +45,9 @@ gbe_program_delete_cb *interp_program_delete = NULL;
 gbe_program_get_kernel_num_cb *interp_program_get_kernel_num = NULL;
 gbe_program_get_kernel_by_name_cb *interp_program_get_kernel_by_name = NULL;
 gbe_program_get_kernel_cb *interp_program_get_kernel = NULL;
+gbe_program_get_kernel_name_cb *interp_program_get_kernel_name = NULL;
+gbe_program_take_lazy_log_cb *interp_program_take_lazy_log = NULL;
+gbe_program_get_ocl_version_cb *interp_program_get_ocl_version = NULL;
 gbe_program_get_device_enqueue_kernel_name_cb *interp_program_get_device_enqueue_kernel_name = NULL;
 gbe_kernel_get_name_cb *interp_kernel_get_name = NULL;
 gbe_kernel_get_attributes_cb *interp_kernel_get_attributes = NULL;
@@ -58,6 +61,7 @@ gbe_kernel_get_arg_align_cb *interp_kernel_get_arg_align = NULL;
 gbe_kernel_get_simd_width_cb *interp_kernel_get_simd_width = NULL;
 gbe_kernel_get_curbe_offset_cb *interp_kernel_get_curbe_offset = NULL;
 gbe_kernel_get_curbe_size_cb *interp_kernel_get_curbe_size = NULL;
+gbe_kernel_get_cross_thread_curbe_size_cb *interp_kernel_get_cross_thread_curbe_size = NULL;
 gbe_kernel_get_stack_size_cb *interp_kernel_get_stack_size = NULL;
 gbe_kernel_get_scratch_size_cb *interp_kernel_get_scratch_size = NULL;
 gbe_kernel_get_required_work_group_size_cb *interp_kernel_get_required_work_group_size = NULL;
@@ -140,6 +144,18 @@ struct GbeLoaderInitializer
     if (interp_program_get_kernel == NULL)
       return false;
 
+    interp_program_get_kernel_name = *(gbe_program_get_kernel_name_cb**)dlsym(dlhInterp, "gbe_program_get_kernel_name");
+    if (interp_program_get_kernel_name == NULL)
+      return false;
+
+    interp_program_take_lazy_log = *(gbe_program_take_lazy_log_cb**)dlsym(dlhInterp, "gbe_program_take_lazy_log");
+    if (interp_program_take_lazy_log == NULL)
+      return false;
+
+    interp_program_get_ocl_version = *(gbe_program_get_ocl_version_cb**)dlsym(dlhInterp, "gbe_program_get_ocl_version");
+    if (interp_program_get_ocl_version == NULL)
+      return false;
+
     interp_program_get_device_enqueue_kernel_name = *(gbe_program_get_device_enqueue_kernel_name_cb**)dlsym(dlhInterp, "gbe_program_get_device_enqueue_kernel_name");
     if (interp_program_get_device_enqueue_kernel_name == NULL)
       return false;
@@ -192,6 +208,10 @@ struct GbeLoaderInitializer
     if (interp_kernel_get_curbe_size == NULL)
       return false;
 
+    interp_kernel_get_cross_thread_curbe_size = *(gbe_kernel_get_cross_thread_curbe_size_cb**)dlsym(dlhInterp, "gbe_kernel_get_cross_thread_curbe_size");
+    if (interp_kernel_get_cross_thread_curbe_size == NULL)
+      return false;
+
     interp_kernel_get_stack_size = *(gbe_kernel_get_stack_size_cb**)dlsym(dlhInterp, "gbe_kernel_get_stack_size");
     if (interp_kernel_get_stack_size == NULL)
       return false;
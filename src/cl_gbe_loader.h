@@ -45,6 +45,9 @@ extern gbe_program_delete_cb *interp_program_delete;
 extern gbe_program_get_kernel_num_cb *interp_program_get_kernel_num;
 extern gbe_program_get_kernel_by_name_cb *interp_program_get_kernel_by_name;
 extern gbe_program_get_kernel_cb *interp_program_get_kernel;
+extern gbe_program_get_kernel_name_cb *interp_program_get_kernel_name;
+extern gbe_program_take_lazy_log_cb *interp_program_take_lazy_log;
+extern gbe_program_get_ocl_version_cb *interp_program_get_ocl_version;
 extern gbe_program_get_device_enqueue_kernel_name_cb *interp_program_get_device_enqueue_kernel_name;
 extern gbe_kernel_get_name_cb *interp_kernel_get_name;
 extern gbe_kernel_get_attributes_cb *interp_kernel_get_attributes;
@@ -58,6 +61,7 @@ extern gbe_kernel_get_arg_align_cb *interp_kernel_get_arg_align;
 extern gbe_kernel_get_simd_width_cb *interp_kernel_get_simd_width;
 extern gbe_kernel_get_curbe_offset_cb *interp_kernel_get_curbe_offset;
 extern gbe_kernel_get_curbe_size_cb *interp_kernel_get_curbe_size;
+extern gbe_kernel_get_cross_thread_curbe_size_cb *interp_kernel_get_cross_thread_curbe_size;
 extern gbe_kernel_get_stack_size_cb *interp_kernel_get_stack_size;
 extern gbe_kernel_get_scratch_size_cb *interp_kernel_get_scratch_size;
 extern gbe_kernel_get_required_work_group_size_cb *interp_kernel_get_required_work_group_size;
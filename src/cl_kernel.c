@@ -35,11 +35,199 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* Process wide pool of the uploaded kernel code. The first context setting
+ * up some code uploads it, every other kernel of that buffer manager with the
+ * same code then shares the BO. Another context imports it through a dma-buf
+ * exported for that import only, so the pool keeps no file descriptor open.
+ * Each kernel holds its buffer manager's BO, which keeps its context alive. */
+typedef struct _cl_kernel_code {
+  struct _cl_kernel_code *next;
+  uint64_t hash;              /* FNV-1a of the code */
+  uint32_t size;              /* Code size in bytes */
+  char *code;                 /* Copy of the code to rule out hash collisions */
+  struct _cl_kernel_isa *isa; /* BOs of the code, one per buffer manager */
+} cl_kernel_code;
+
+typedef struct _cl_kernel_isa {
+  struct _cl_kernel_isa *next;
+  cl_kernel_code *code;       /* Code the BO holds */
+  cl_buffer_mgr bufmgr;       /* Buffer manager of the BO */
+  cl_buffer bo;               /* Reference of the pool on the BO */
+  uint32_t ref_n;             /* Number of kernels set up from this BO */
+  uint32_t uploaded:1;        /* The code was uploaded, not imported */
+} cl_kernel_isa;
+
+static cl_kernel_code *kernel_code_pool = NULL;
+static pthread_mutex_t kernel_isa_lock = PTHREAD_MUTEX_INITIALIZER;
+static cl_int kernel_isa_upload_n = 0;
+
+static uint64_t
+cl_kernel_isa_hash(const char *code, uint32_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  uint32_t i;
+  for (i = 0; i < size; ++i) {
+    hash ^= (unsigned char)code[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/* Import the code already uploaded by another buffer manager */
+static cl_buffer
+cl_kernel_isa_import(cl_context ctx, cl_kernel_code *code)
+{
+  cl_buffer bo = NULL;
+  int fd;
+
+  if (code->isa == NULL || cl_buffer_get_fd(code->isa->bo, &fd) != 0)
+    return NULL;
+  bo = cl_buffer_get_buffer_from_fd(ctx, fd, code->size);
+  close(fd);
+  return bo;
+}
+
+/* Get a BO holding the given code for the context of k. The BO is shared
+ * with every kernel of the process set up with the same code, k->isa records
+ * the pool entry it comes from if any */
+static cl_buffer
+cl_kernel_isa_acquire(cl_kernel k, const char *code, uint32_t size)
+{
+  cl_context ctx = k->program->ctx;
+  cl_buffer_mgr bufmgr = cl_context_get_bufmgr(ctx);
+  const uint64_t hash = cl_kernel_isa_hash(code, size);
+  cl_kernel_code *entry = NULL;
+  cl_kernel_isa *isa = NULL;
+  cl_buffer bo = NULL;
+  cl_bool uploaded = CL_FALSE;
+
+  pthread_mutex_lock(&kernel_isa_lock);
+  for (entry = kernel_code_pool; entry != NULL; entry = entry->next)
+    if (entry->hash == hash && entry->size == size && memcmp(entry->code, code, size) == 0)
+      break;
+
+  if (entry != NULL) {
+    for (isa = entry->isa; isa != NULL; isa = isa->next)
+      if (isa->bufmgr == bufmgr)
+        break;
+    if (isa != NULL) {
+      bo = isa->bo;
+      cl_buffer_reference(bo);
+      isa->ref_n++;
+      k->isa = isa;
+      goto exit;
+    }
+    bo = cl_kernel_isa_import(ctx, entry);
+  }
+
+  /* Not in the pool, or the import failed: upload the code here */
+  if (bo == NULL) {
+    bo = cl_buffer_alloc(bufmgr, "CL kernel", size, 64u);
+    if (bo == NULL)
+      goto exit;
+    cl_buffer_subdata(bo, 0, size, code);
+    uploaded = CL_TRUE;
+  }
+
+  if (entry == NULL) {
+    entry = cl_calloc(1, sizeof(cl_kernel_code));
+    if (entry == NULL || (entry->code = cl_malloc(size)) == NULL) {
+      cl_free(entry);
+      goto exit;
+    }
+    memcpy(entry->code, code, size);
+    entry->hash = hash;
+    entry->size = size;
+    entry->next = kernel_code_pool;
+    kernel_code_pool = entry;
+  }
+
+  isa = cl_calloc(1, sizeof(cl_kernel_isa));
+  if (isa == NULL) {
+    if (entry->isa == NULL) {
+      kernel_code_pool = entry->next;
+      cl_free(entry->code);
+      cl_free(entry);
+    }
+    goto exit;
+  }
+  isa->code = entry;
+  isa->bufmgr = bufmgr;
+  isa->bo = bo;
+  cl_buffer_reference(bo);
+  isa->ref_n = 1;
+  isa->uploaded = uploaded;
+  if (uploaded)
+    kernel_isa_upload_n++;
+  isa->next = entry->isa;
+  entry->isa = isa;
+  k->isa = isa;
+
+exit:
+  pthread_mutex_unlock(&kernel_isa_lock);
+  return bo;
+}
+
+static void
+cl_kernel_isa_release(cl_kernel_isa *isa)
+{
+  cl_kernel_code *entry = isa->code;
+  cl_kernel_code **prev_code;
+  cl_kernel_isa **prev;
+
+  pthread_mutex_lock(&kernel_isa_lock);
+  if (--isa->ref_n == 0) {
+    for (prev = &entry->isa; *prev != isa; prev = &(*prev)->next)
+      ;
+    *prev = isa->next;
+    if (isa->uploaded)
+      kernel_isa_upload_n--;
+    cl_buffer_unreference(isa->bo);
+    cl_free(isa);
+
+    if (entry->isa == NULL) {
+      for (prev_code = &kernel_code_pool; *prev_code != entry; prev_code = &(*prev_code)->next)
+        ;
+      *prev_code = entry->next;
+      cl_free(entry->code);
+      cl_free(entry);
+    }
+  }
+  pthread_mutex_unlock(&kernel_isa_lock);
+}
+
+LOCAL cl_int
+cl_kernel_isa_upload_n(void)
+{
+  cl_int n;
+
+  pthread_mutex_lock(&kernel_isa_lock);
+  n = kernel_isa_upload_n;
+  pthread_mutex_unlock(&kernel_isa_lock);
+  return n;
+}
+
+/* Release the curbe and the argument array */
+static void
+cl_kernel_release_args(cl_kernel k)
+{
+  uint32_t i;
+
+  if (k->curbe) cl_free(k->curbe);
+  if (k->args) {
+    for (i = 0; i < k->arg_n; ++i)
+      if (k->args[i].mem != NULL)
+        cl_mem_delete(k->args[i].mem);
+    cl_free(k->args);
+  }
+}
 
 LOCAL void
 cl_kernel_delete(cl_kernel k)
 {
-  uint32_t i;
   if (k == NULL) return;
 
 #ifdef HAS_CMRT
@@ -55,30 +243,47 @@ cl_kernel_delete(cl_kernel k)
   if (CL_OBJECT_DEC_REF(k) > 1)
     return;
 
+  /* An argument snapshot only owns its curbe and arguments */
+  if (k->parent) {
+    cl_kernel_release_args(k);
+    cl_kernel_delete(k->parent);
+    CL_OBJECT_DESTROY_BASE(k);
+    cl_free(k);
+    return;
+  }
+
   /* Release one reference on all bos we own */
   if (k->bo)       cl_buffer_unreference(k->bo);
+  if (k->isa)      cl_kernel_isa_release(k->isa);
   /* This will be true for kernels created by clCreateKernel */
   if (k->ref_its_program) cl_program_delete(k->program);
-  /* Release the curbe if allocated */
-  if (k->curbe) cl_free(k->curbe);
-  /* Release the argument array if required */
-  if (k->args) {
-    for (i = 0; i < k->arg_n; ++i)
-      if (k->args[i].mem != NULL)
-        cl_mem_delete(k->args[i].mem);
-    cl_free(k->args);
-  }
+  cl_kernel_release_args(k);
   if (k->image_sz)
     cl_free(k->images);
 
   if (k->exec_info)
     cl_free(k->exec_info);
 
+  if (k->lws_tune)
+    cl_free(k->lws_tune);
+
+  if (k->dispatch.arg)
+    cl_free(k->dispatch.arg);
+  if (k->payload.data)
+    cl_free(k->payload.data);
+
   if (k->device_enqueue_ptr)
     cl_mem_svm_delete(k->program->ctx, k->device_enqueue_ptr);
   if (k->device_enqueue_infos)
     cl_free(k->device_enqueue_infos);
 
+  while (k->stages) {
+    cl_kernel_stage *stage = k->stages;
+    k->stages = stage->next;
+    cl_kernel_delete(stage->args);
+    cl_free(stage);
+  }
+
   CL_OBJECT_DESTROY_BASE(k);
 
   cl_free(k);
@@ -196,7 +401,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
     if (k->vme && index == 0) {
       cl_accelerator_intel accel;
       memcpy(&accel, value, sz);
-      offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, index);
+      offset = k->dispatch.arg[index];
       if (offset >= 0) {
         assert(offset + sz <= k->curbe_sz);
         memcpy(k->curbe + offset, &(accel->desc.me), arg_sz);
@@ -207,7 +412,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
       k->accel = accel;
       return CL_SUCCESS;
     } else {
-      offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, index);
+      offset = k->dispatch.arg[index];
       if (offset >= 0) {
         assert(offset + sz <= k->curbe_sz);
         memcpy(k->curbe + offset, value, sz);
@@ -236,7 +441,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
     k->args[index].mem = NULL;
     k->args[index].sampler = sampler;
     cl_set_sampler_arg_slot(k, index, sampler);
-    offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, index);
+    offset = k->dispatch.arg[index];
     if (offset >= 0) {
       assert(offset + 4 <= k->curbe_sz);
       memcpy(k->curbe + offset, &sampler->clkSamplerValue, 4);
@@ -249,7 +454,7 @@ cl_kernel_set_arg(cl_kernel k, cl_uint index, size_t sz, const void *value)
 
   if(value == NULL || mem == NULL) {
     /* for buffer object GLOBAL_PTR CONSTANT_PTR, it maybe NULL */
-    int32_t offset = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, index);
+    int32_t offset = k->dispatch.arg[index];
     if (offset >= 0)
       *((uint32_t *)(k->curbe + offset)) = 0;
     assert(arg_type == GBE_ARG_GLOBAL_PTR || arg_type == GBE_ARG_CONSTANT_PTR);
@@ -310,6 +515,235 @@ cl_kernel_set_arg_svm_pointer(cl_kernel k, cl_uint index, const void *value)
   return 0;
 }
 
+/* Copy argument index, set in from, to another copy of the same kernel */
+static void
+cl_kernel_copy_arg(cl_kernel to, cl_kernel from, cl_uint index)
+{
+  const enum gbe_arg_type arg_type = interp_kernel_get_arg_type(to->opaque, index);
+  const int32_t offset = to->dispatch.arg[index];
+  cl_argument *arg = &to->args[index];
+  size_t sz = 0;
+
+  if (from->args[index].mem)
+    cl_mem_add_ref(from->args[index].mem);
+  if (arg->mem)
+    cl_mem_delete(arg->mem);
+  *arg = from->args[index];
+
+  /* Only the values cl_kernel_set_arg wrote in the curbe */
+  if (arg_type == GBE_ARG_VALUE)
+    sz = interp_kernel_get_arg_size(to->opaque, index);
+  else if (arg_type == GBE_ARG_SAMPLER) {
+    sz = 4;
+    cl_set_sampler_arg_slot(to, index, arg->sampler);
+  } else if ((arg_type == GBE_ARG_GLOBAL_PTR || arg_type == GBE_ARG_CONSTANT_PTR) && arg->mem == NULL)
+    sz = sizeof(uint32_t);
+  if (offset >= 0 && sz > 0)
+    memcpy(to->curbe + offset, from->curbe + offset, sz);
+  if (to->vme && index == 0)
+    to->accel = from->accel;
+}
+
+/* Staging slot of the calling thread, 0 until it is first needed. A slot is
+   given back when its thread exits and taken over by the next new thread, so
+   a kernel keeps at most one stage per thread alive at the same time. The
+   serial tells the stage of a dead thread from the one of its slot's owner */
+static __thread int cl_thread_slot = 0;
+static __thread int cl_thread_serial = 0;
+static atomic_t cl_thread_n = 0;
+static pthread_once_t thread_slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_slot_key;
+static pthread_mutex_t thread_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static int *thread_slot_free = NULL;
+static int thread_slot_free_n = 0;
+static int thread_slot_n = 0;
+
+static void
+cl_thread_slot_put(void *value)
+{
+  int slot = (int)(intptr_t)value;
+  int *free_slots;
+
+  pthread_mutex_lock(&thread_slot_lock);
+  /* Never more free slots than slots, the array holds them all */
+  free_slots = cl_realloc(thread_slot_free, thread_slot_n * sizeof(int));
+  if (free_slots != NULL) {
+    thread_slot_free = free_slots;
+    thread_slot_free[thread_slot_free_n++] = slot;
+  }
+  pthread_mutex_unlock(&thread_slot_lock);
+}
+
+static void
+cl_thread_slot_init(void)
+{
+  pthread_key_create(&thread_slot_key, cl_thread_slot_put);
+}
+
+static int
+cl_thread_slot_get(void)
+{
+  int slot;
+
+  pthread_once(&thread_slot_once, cl_thread_slot_init);
+  pthread_mutex_lock(&thread_slot_lock);
+  if (thread_slot_free_n > 0)
+    slot = thread_slot_free[--thread_slot_free_n];
+  else
+    slot = ++thread_slot_n;
+  pthread_mutex_unlock(&thread_slot_lock);
+
+  /* The key value must not be NULL for the destructor to run, slots start at 1 */
+  pthread_setspecific(thread_slot_key, (void *)(intptr_t)slot);
+  cl_thread_serial = atomic_inc(&cl_thread_n) + 1;
+  return slot;
+}
+
+/* Drop the staged value of an argument */
+static void
+cl_kernel_unstage_arg(cl_kernel stage, uint32_t index)
+{
+  if (stage->args[index].mem)
+    cl_mem_delete(stage->args[index].mem);
+  stage->args[index].mem = NULL;
+  stage->args[index].is_set = 0;
+}
+
+/* Find the calling thread's staging copy of the arguments. The stage of its
+   slot only belongs to it, the arguments a dead thread left there are dropped */
+static cl_kernel
+cl_kernel_find_stage(cl_kernel k)
+{
+  cl_kernel_stage *stage;
+  uint32_t i;
+
+  if (cl_thread_slot == 0)
+    return NULL;
+  for (stage = k->stages; stage != NULL; stage = stage->next)
+    if (stage->slot == cl_thread_slot)
+      break;
+  if (stage == NULL)
+    return NULL;
+
+  if (stage->serial != cl_thread_serial) {
+    for (i = 0; i < k->arg_n; ++i)
+      if (stage->args->args[i].is_set)
+        cl_kernel_unstage_arg(stage->args, i);
+    stage->serial = cl_thread_serial;
+  }
+  return stage->args;
+}
+
+static cl_kernel
+cl_kernel_get_stage(cl_kernel k)
+{
+  cl_kernel_stage *stage = NULL;
+  cl_kernel args;
+
+  if (cl_thread_slot == 0)
+    cl_thread_slot = cl_thread_slot_get();
+  if ((args = cl_kernel_find_stage(k)) != NULL)
+    return args;
+
+  /* Only the owner of the slot adds its stage, no other can race with us */
+  TRY_ALLOC_NO_ERR (stage, CALLOC(cl_kernel_stage));
+  TRY_ALLOC_NO_ERR (stage->args, cl_kernel_dup(k));
+  stage->slot = cl_thread_slot;
+  stage->serial = cl_thread_serial;
+  do {
+    stage->next = k->stages;
+  } while (!atomic_cmpxchg_ptr((void * volatile *) &k->stages, stage->next, stage));
+  return stage->args;
+
+error:
+  if (stage)
+    cl_free(stage);
+  return NULL;
+}
+
+LOCAL cl_int
+cl_kernel_stage_arg(cl_kernel k, cl_uint index, size_t sz, const void *value, cl_bool is_svm)
+{
+  cl_kernel stage = NULL;
+  cl_int err = CL_SUCCESS;
+
+  if (UNLIKELY(index >= k->arg_n))
+    return CL_INVALID_ARG_INDEX;
+  if (UNLIKELY((stage = cl_kernel_get_stage(k)) == NULL))
+    return CL_OUT_OF_HOST_MEMORY;
+
+  /* The staging copy validates the value, nobody else writes it */
+  if (is_svm)
+    err = cl_kernel_set_arg_svm_pointer(stage, index, value);
+  else
+    err = cl_kernel_set_arg(stage, index, sz, value);
+  if (err != CL_SUCCESS)
+    return err;
+
+  /* Threads that never set this argument launch with this value */
+  CL_OBJECT_LOCK(k);
+  cl_kernel_copy_arg(k, stage, index);
+  CL_OBJECT_UNLOCK(k);
+  return CL_SUCCESS;
+}
+
+LOCAL cl_kernel
+cl_kernel_snapshot(cl_kernel k)
+{
+  cl_kernel snap = NULL, stage = NULL;
+  uint32_t i;
+
+  /* Device side enqueue keeps its buffers in the kernel object itself */
+  if (k->dispatch.curbe[GBE_CURBE_ENQUEUE_BUF_POINTER] >= 0) {
+    cl_kernel_add_ref(k);
+    return k;
+  }
+
+  /* Everything but the curbe and the arguments is shared with k, which the
+     snapshot keeps alive */
+  TRY_ALLOC_NO_ERR (snap, cl_malloc(sizeof(struct _cl_kernel)));
+  CL_OBJECT_LOCK(k);
+  *snap = *k;
+  snap->curbe = NULL;
+  snap->args = cl_calloc(k->arg_n ? k->arg_n : 1, sizeof(cl_argument));
+  if (snap->args && k->curbe_sz && (snap->curbe = cl_malloc(k->curbe_sz)) != NULL)
+    memcpy(snap->curbe, k->curbe, k->curbe_sz);
+  if (snap->args && (snap->curbe || !k->curbe_sz)) {
+    memcpy(snap->args, k->args, k->arg_n * sizeof(cl_argument));
+    for (i = 0; i < k->arg_n; ++i)
+      if (snap->args[i].mem)
+        cl_mem_add_ref(snap->args[i].mem);
+  }
+  CL_OBJECT_UNLOCK(k);
+  CL_OBJECT_INIT_BASE(snap, CL_OBJECT_KERNEL_MAGIC);
+  snap->isa = NULL;
+  snap->cmrt_kernel = NULL;
+  snap->lws_tune = NULL;
+  snap->stages = NULL;
+  memset(&snap->payload, 0, sizeof(snap->payload));
+  cl_kernel_add_ref(k);
+  snap->parent = k;
+  if (snap->args == NULL || (k->curbe_sz && snap->curbe == NULL)) {
+    cl_free(snap->args);
+    snap->args = NULL;
+    goto error;
+  }
+
+  /* The calling thread's arguments go with this launch only, the next ones
+     see the kernel object's unless it sets them again */
+  if ((stage = cl_kernel_find_stage(k)) != NULL)
+    for (i = 0; i < k->arg_n; ++i)
+      if (stage->args[i].is_set) {
+        cl_kernel_copy_arg(snap, stage, i);
+        cl_kernel_unstage_arg(stage, i);
+      }
+  return snap;
+
+error:
+  cl_kernel_delete(snap);
+  return NULL;
+}
+
 LOCAL cl_int
 cl_kernel_set_exec_info(cl_kernel k, size_t n, const void *value)
 {
@@ -421,23 +855,46 @@ cl_kernel_get_simd_width(cl_kernel k)
   return interp_kernel_get_simd_width(k->opaque);
 }
 
+/* Gather the curbe offsets the launches patch */
+static cl_int
+cl_kernel_setup_dispatch(cl_kernel k)
+{
+  cl_dispatch_desc *desc = &k->dispatch;
+  cl_int err = CL_SUCCESS;
+  uint32_t i;
+
+  for (i = 0; i < GBE_GEN_REG; ++i)
+    desc->curbe[i] = interp_kernel_get_curbe_offset(k->opaque, i, 0);
+
+  if (desc->arg)
+    cl_free(desc->arg);
+  desc->arg = NULL;
+  if (k->arg_n == 0)
+    return CL_SUCCESS;
+  TRY_ALLOC(desc->arg, cl_calloc(k->arg_n, sizeof(int32_t)));
+  for (i = 0; i < k->arg_n; ++i)
+    desc->arg[i] = interp_kernel_get_curbe_offset(k->opaque, GBE_CURBE_KERNEL_ARGUMENT, i);
+
+error:
+  return err;
+}
+
 LOCAL void
 cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
 {
   cl_context ctx = k->program->ctx;
-  cl_buffer_mgr bufmgr = cl_context_get_bufmgr(ctx);
 
   if(k->bo != NULL)
     cl_buffer_unreference(k->bo);
+  if (k->isa != NULL)
+    cl_kernel_isa_release(k->isa);
+  k->isa = NULL;
 
-  /* Allocate the gen code here */
+  /* Get the gen code uploaded, or shared with an identical upload */
   const uint32_t code_sz = interp_kernel_get_code_size(opaque);
   const char *code = interp_kernel_get_code(opaque);
-  k->bo = cl_buffer_alloc(bufmgr, "CL kernel", code_sz, 64u);
+  k->bo = cl_kernel_isa_acquire(k, code, code_sz);
   k->arg_n = interp_kernel_get_arg_num(opaque);
-
-  /* Upload the code */
-  cl_buffer_subdata(k->bo, 0, code_sz, code);
   k->opaque = opaque;
 
   const char* kname = cl_kernel_get_name(k);
@@ -449,6 +906,8 @@ cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
 
   /* Create the curbe */
   k->curbe_sz = interp_kernel_get_curbe_size(k->opaque);
+  if (cl_kernel_setup_dispatch(k) != CL_SUCCESS)
+    goto error;
 
   /* Get sampler data & size */
   k->sampler_sz = interp_kernel_get_sampler_size(k->opaque);
@@ -470,6 +929,9 @@ cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
 error:
   cl_buffer_unreference(k->bo);
   k->bo = NULL;
+  if (k->isa != NULL)
+    cl_kernel_isa_release(k->isa);
+  k->isa = NULL;
 }
 
 LOCAL cl_kernel
@@ -503,6 +965,11 @@ cl_kernel_dup(cl_kernel from)
     TRY_ALLOC_NO_ERR(to->exec_info, cl_calloc(to->exec_info_n, sizeof(void *)));
     memcpy(to->exec_info, from->exec_info, to->exec_info_n * sizeof(void *));
   }
+  memcpy(to->dispatch.curbe, from->dispatch.curbe, sizeof(from->dispatch.curbe));
+  if (to->arg_n) {
+    TRY_ALLOC_NO_ERR(to->dispatch.arg, cl_calloc(to->arg_n, sizeof(int32_t)));
+    memcpy(to->dispatch.arg, from->dispatch.arg, to->arg_n * sizeof(int32_t));
+  }
   TRY_ALLOC_NO_ERR(to->args, cl_calloc(to->arg_n, sizeof(cl_argument)));
   if (to->curbe_sz) TRY_ALLOC_NO_ERR(to->curbe, cl_calloc(1, to->curbe_sz));
 
@@ -556,3 +1023,258 @@ error:
 }
 
 
+
+/* Score a local size from the hardware occupancy it gives, the higher the better */
+static size_t
+cl_kernel_local_sz_score(cl_device_id dev, uint32_t simd_sz, size_t slm_sz, cl_bool use_slm,
+                         const size_t *global_wk_sz, const size_t *local_wk_sz)
+{
+  const size_t group_sz = local_wk_sz[0] * local_wk_sz[1] * local_wk_sz[2];
+  const size_t group_n = (global_wk_sz[0] / local_wk_sz[0]) *
+                         (global_wk_sz[1] / local_wk_sz[1]) *
+                         (global_wk_sz[2] / local_wk_sz[2]);
+  const size_t thread_n = (group_sz + simd_sz - 1) / simd_sz;
+  const size_t hw_thread_n = dev->max_compute_unit * dev->max_thread_per_unit;
+  const size_t subslice_n = dev->sub_slice_count ? dev->sub_slice_count : 1;
+  size_t group_per_subslice, resident, lane_use, occupancy;
+
+  /* The lanes left in the last thread of a group are wasted */
+  lane_use = group_sz * 1000 / (thread_n * simd_sz);
+
+  /* All the threads of a group run on one sub slice and share its SLM */
+  group_per_subslice = hw_thread_n / subslice_n / thread_n;
+  if (slm_sz)
+    group_per_subslice = MIN(group_per_subslice, dev->local_mem_size / slm_sz);
+  if (group_per_subslice == 0)
+    group_per_subslice = 1;
+  resident = MIN(group_n, group_per_subslice * subslice_n) * thread_n;
+  occupancy = MIN(resident, hw_thread_n) * 1000 / hw_thread_n;
+
+  /* A lone group per sub slice leaves the EUs idle at each barrier */
+  if (use_slm && group_per_subslice < 2 && group_n > subslice_n)
+    occupancy = occupancy * 3 / 4;
+
+  return lane_use * occupancy;
+}
+
+static cl_uint
+cl_kernel_local_sz_divisors(size_t global_sz, size_t max_sz, size_t *divs, cl_uint max_n)
+{
+  cl_uint n = 0;
+  size_t d;
+  for (d = 1; d <= max_sz && d <= global_sz && n < max_n; d++)
+    if (global_sz % d == 0)
+      divs[n++] = d;
+  return n;
+}
+
+/* Size of the __local arguments, they change the best local size */
+static size_t
+cl_kernel_local_arg_sz(cl_kernel ker)
+{
+  size_t sz = 0;
+  cl_uint i;
+
+  for (i = 0; i < ker->arg_n; ++i)
+    if (interp_kernel_get_arg_type(ker->opaque, i) == GBE_ARG_LOCAL_PTR)
+      sz += ker->args[i].local_sz;
+  return sz;
+}
+
+/* Rank the local sizes dividing the global size, best first */
+static cl_uint
+cl_kernel_rank_local_sz(cl_kernel ker, cl_uint wk_dim, const size_t *global_wk_sz,
+                        size_t cand[][3], size_t *score, cl_uint cand_max)
+{
+  cl_device_id dev = ker->program->ctx->devices[0];
+  const uint32_t simd_sz = cl_kernel_get_simd_width(ker);
+  const cl_bool use_slm = interp_kernel_use_slm(ker->opaque) ? CL_TRUE : CL_FALSE;
+  const size_t max_sz = cl_get_kernel_max_wg_sz(ker);
+  size_t global_sz[3] = {1, 1, 1};
+  size_t divs[3][128];
+  cl_uint div_n[3] = {1, 1, 1};
+  const size_t slm_sz = interp_kernel_get_slm_size(ker->opaque) + cl_kernel_local_arg_sz(ker);
+  cl_uint i, j, k, c, n = 0;
+
+  divs[1][0] = divs[2][0] = 1;
+  for (i = 0; i < wk_dim; ++i) {
+    global_sz[i] = global_wk_sz[i];
+    div_n[i] = cl_kernel_local_sz_divisors(global_sz[i], max_sz, divs[i], 128);
+  }
+
+  for (i = 0; i < div_n[0]; ++i)
+  for (j = 0; j < div_n[1] && divs[0][i] * divs[1][j] <= max_sz; ++j)
+  for (k = 0; k < div_n[2] && divs[0][i] * divs[1][j] * divs[2][k] <= max_sz; ++k) {
+    const size_t local_sz[3] = {divs[0][i], divs[1][j], divs[2][k]};
+    const size_t group_sz = local_sz[0] * local_sz[1] * local_sz[2];
+    const size_t s = cl_kernel_local_sz_score(dev, simd_sz, slm_sz, use_slm, global_sz, local_sz);
+
+    /* Keep the list sorted. On equal scores, barriers favour smaller groups and
+     * everything else favours larger ones, then the widest first dimension */
+    for (c = 0; c < n; ++c) {
+      const size_t other_sz = cand[c][0] * cand[c][1] * cand[c][2];
+      if (s > score[c])
+        break;
+      if (s == score[c] && group_sz != other_sz && (group_sz < other_sz) == use_slm)
+        break;
+      if (s == score[c] && group_sz == other_sz && local_sz[0] > cand[c][0])
+        break;
+    }
+    if (c == cand_max)
+      continue;
+    if (n < cand_max)
+      n++;
+    memmove(cand[c + 1], cand[c], (n - c - 1) * sizeof(cand[0]));
+    memmove(score + c + 1, score + c, (n - c - 1) * sizeof(score[0]));
+    memcpy(cand[c], local_sz, sizeof(local_sz));
+    score[c] = s;
+  }
+
+  return n;
+}
+
+static pthread_once_t tune_rounds_once = PTHREAD_ONCE_INIT;
+static int tune_rounds = 0;
+
+static void
+cl_kernel_read_tune_rounds(void)
+{
+  const char *env = getenv("OCL_TUNE_LOCAL_SIZE");
+  if (env != NULL)
+    tune_rounds = atoi(env);
+  if (tune_rounds < 0)
+    tune_rounds = 0;
+}
+
+static int
+cl_kernel_tune_rounds(void)
+{
+  /* Kernels are enqueued from several threads at once */
+  pthread_once(&tune_rounds_once, cl_kernel_read_tune_rounds);
+  return tune_rounds;
+}
+
+/* Pick the local size of a tuning launch, called with the kernel locked */
+static cl_int
+cl_kernel_tune_local_sz(cl_kernel ker, const size_t *global_sz, size_t local_arg_sz,
+                        size_t *local_wk_sz)
+{
+  const uint32_t rounds = cl_kernel_tune_rounds();
+  cl_lws_tune_entry *e = NULL;
+  size_t score[CL_LWS_TUNE_CANDIDATES];
+  cl_uint i;
+
+  if (ker->lws_tune == NULL) {
+    ker->lws_tune = cl_calloc(CL_LWS_TUNE_ENTRIES, sizeof(cl_lws_tune_entry));
+    if (ker->lws_tune == NULL)
+      return -1;
+  }
+
+  for (i = 0; i < CL_LWS_TUNE_ENTRIES; ++i) {
+    if (ker->lws_tune[i].cand_n == 0 ||
+        (ker->lws_tune[i].local_arg_sz == local_arg_sz &&
+         memcmp(ker->lws_tune[i].global_sz, global_sz, sizeof(ker->lws_tune[i].global_sz)) == 0)) {
+      e = &ker->lws_tune[i];
+      break;
+    }
+  }
+  /* Table full, stay with the static advice */
+  if (e == NULL)
+    return -1;
+
+  if (e->cand_n == 0) {
+    memcpy(e->global_sz, global_sz, sizeof(e->global_sz));
+    e->local_arg_sz = local_arg_sz;
+    memcpy(e->candidates[0], local_wk_sz, sizeof(e->candidates[0]));
+    e->cand_n = cl_kernel_rank_local_sz(ker, 3, global_sz, e->candidates, score,
+                                        CL_LWS_TUNE_CANDIDATES);
+    if (e->cand_n == 0)
+      e->cand_n = 1;
+    for (i = 0; i < CL_LWS_TUNE_CANDIDATES; ++i)
+      e->time[i] = CL_ULONG_MAX;
+  }
+
+  if (e->reported == e->cand_n * rounds) {
+    memcpy(local_wk_sz, e->candidates[e->best], sizeof(e->candidates[0]));
+    return -1;
+  }
+  if (e->launched == e->cand_n * rounds) {
+    /* Still waiting for the timings */
+    memcpy(local_wk_sz, e->candidates[0], sizeof(e->candidates[0]));
+    return -1;
+  }
+
+  i = e->launched++ % e->cand_n;
+  memcpy(local_wk_sz, e->candidates[i], sizeof(e->candidates[0]));
+  return (e - ker->lws_tune) * CL_LWS_TUNE_CANDIDATES + i;
+}
+
+LOCAL cl_int
+cl_kernel_advise_local_sz(cl_kernel ker,
+                          cl_uint wk_dim,
+                          const size_t *global_wk_sz,
+                          size_t *local_wk_sz)
+{
+  size_t global_sz[3] = {1, 1, 1};
+  size_t cand[1][3], score[1];
+  size_t local_arg_sz;
+  cl_int slot = -1;
+  cl_uint i;
+
+  /* The compiler already knows it */
+  if (ker->compile_wg_sz[0] || ker->compile_wg_sz[1] || ker->compile_wg_sz[2]) {
+    for (i = 0; i < wk_dim; ++i)
+      local_wk_sz[i] = ker->compile_wg_sz[i];
+    return -1;
+  }
+
+  for (i = 0; i < wk_dim; ++i)
+    global_sz[i] = global_wk_sz[i];
+
+  CL_OBJECT_LOCK(ker);
+  local_arg_sz = cl_kernel_local_arg_sz(ker);
+  if (ker->lws_advice_local_arg == local_arg_sz &&
+      memcmp(ker->lws_advice_global, global_sz, sizeof(global_sz)) == 0) {
+    memcpy(local_wk_sz, ker->lws_advice, wk_dim * sizeof(size_t));
+  } else {
+    if (cl_kernel_rank_local_sz(ker, wk_dim, global_sz, cand, score, 1) == 0) {
+      cand[0][0] = cand[0][1] = cand[0][2] = 1;
+    }
+    memcpy(ker->lws_advice_global, global_sz, sizeof(global_sz));
+    ker->lws_advice_local_arg = local_arg_sz;
+    memcpy(ker->lws_advice, cand[0], sizeof(cand[0]));
+    memcpy(local_wk_sz, cand[0], wk_dim * sizeof(size_t));
+  }
+
+  if (cl_kernel_tune_rounds() > 0) {
+    size_t tuned_sz[3] = {1, 1, 1};
+    memcpy(tuned_sz, local_wk_sz, wk_dim * sizeof(size_t));
+    slot = cl_kernel_tune_local_sz(ker, global_sz, local_arg_sz, tuned_sz);
+    memcpy(local_wk_sz, tuned_sz, wk_dim * sizeof(size_t));
+  }
+  CL_OBJECT_UNLOCK(ker);
+
+  return slot;
+}
+
+LOCAL void
+cl_kernel_tune_report(cl_kernel ker, cl_int slot, cl_ulong time)
+{
+  cl_lws_tune_entry *e;
+  const uint32_t rounds = cl_kernel_tune_rounds();
+  cl_uint i, cand = slot % CL_LWS_TUNE_CANDIDATES;
+
+  assert(slot >= 0 && slot < CL_LWS_TUNE_ENTRIES * CL_LWS_TUNE_CANDIDATES);
+  CL_OBJECT_LOCK(ker);
+  e = &ker->lws_tune[slot / CL_LWS_TUNE_CANDIDATES];
+  if (time < e->time[cand])
+    e->time[cand] = time;
+  e->reported++;
+  if (e->reported == e->cand_n * rounds) {
+    e->best = 0;
+    for (i = 1; i < e->cand_n; ++i)
+      if (e->time[i] < e->time[e->best])
+        e->best = i;
+  }
+  CL_OBJECT_UNLOCK(ker);
+}
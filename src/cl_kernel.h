@@ -47,10 +47,61 @@ typedef struct cl_argument {
   uint32_t is_svm:1;    /* Indicate this argument is SVMPointer */
 } cl_argument;
 
+/* Online local size tuning, used when the user lets us choose the local size */
+#define CL_LWS_TUNE_CANDIDATES 4
+#define CL_LWS_TUNE_ENTRIES 8
+
+typedef struct cl_lws_tune_entry {
+  size_t global_sz[3];                           /* Global size this entry is tuned for */
+  size_t local_arg_sz;                           /* __local argument size it is tuned for */
+  size_t candidates[CL_LWS_TUNE_CANDIDATES][3];  /* Best ranked local sizes, best first */
+  cl_ulong time[CL_LWS_TUNE_CANDIDATES];         /* Shortest run time seen per candidate (ns) */
+  uint32_t cand_n;                               /* Number of valid candidates */
+  uint32_t launched;                             /* Tuning launches issued */
+  uint32_t reported;                             /* Tuning launches timed */
+  uint32_t best;                                 /* Winner once all launches are timed */
+} cl_lws_tune_entry;
+
+/* Curbe offsets patched at every launch, looked up once when the kernel is set
+ * up rather than by a search in the compiler's patch list at each launch. The
+ * offsets are -1 when the kernel doesn't use the value.
+ */
+typedef struct cl_dispatch_desc {
+  int32_t curbe[GBE_GEN_REG]; /* Offset of each curbe value, for sub-value 0 */
+  int32_t *arg;               /* Offset of each kernel argument */
+} cl_dispatch_desc;
+
+/* Per thread local IDs, block IPs and thread IDs of one work group shape, so
+ * that launches with the same local size only copy them into the curbes
+ */
+typedef struct cl_payload_template {
+  size_t local_sz[3];         /* Local size this template is built for */
+  uint32_t simd_sz;           /* SIMD width this template is built for */
+  size_t thread_n;            /* Number of threads of the work group */
+  size_t stride;              /* Size of one thread's record */
+  char *data;                 /* thread_n records */
+} cl_payload_template;
+
+/* Arguments one thread set on a kernel shared with other threads, until its
+ * next launch. There is one stage per thread slot, slots are reused when
+ * their thread exits. The list only grows and is walked without locking
+ */
+typedef struct cl_kernel_stage {
+  struct cl_kernel_stage *next;
+  int slot;                   /* Thread slot owning the staging copy */
+  int serial;                 /* Thread that set the staged arguments */
+  struct _cl_kernel *args;    /* Copy of the kernel holding the owner's arguments */
+} cl_kernel_stage;
+
+/* BO of a buffer manager in the process wide pool of kernel code, see
+ * cl_kernel_setup */
+struct _cl_kernel_isa;
+
 /* One OCL function */
 struct _cl_kernel {
   _cl_base_object base;
   cl_buffer bo;               /* The code itself */
+  struct _cl_kernel_isa *isa; /* Pool entry bo was shared from, NULL for dups */
   cl_program program;         /* Owns this structure (and pointers) */
   gbe_kernel opaque;          /* (Opaque) compiler structure for the OCL kernel */
   cl_accelerator_intel accel;     /* accelerator */
@@ -66,7 +117,15 @@ struct _cl_kernel {
   size_t global_work_sz[3];    /* maximum global size that can be used to execute a kernel
                                 (i.e. global_work_size argument to clEnqueueNDRangeKernel.)*/
   size_t stack_size;          /* stack size per work item. */
+  size_t lws_advice_global[3]; /* Global size of the last local size advice */
+  size_t lws_advice_local_arg; /* __local argument size of the last local size advice */
+  size_t lws_advice[3];        /* Last local size advice, computed once per global size */
+  cl_lws_tune_entry *lws_tune; /* Online tuning entries, allocated on first use */
+  cl_dispatch_desc dispatch;   /* Curbe offsets of the kernel */
+  cl_payload_template payload; /* Varying payload of the last work group shape */
   cl_argument *args;          /* To track argument setting */
+  cl_kernel_stage *stages;    /* Per thread staging copies of the arguments */
+  struct _cl_kernel *parent;  /* Kernel an argument snapshot was taken from */
   uint32_t arg_n:30;          /* Number of arguments */
   uint32_t ref_its_program:1; /* True only for the user kernel (created by clCreateKernel) */
   uint32_t vme:1;             /* True only if it is a built-in kernel for VME */
@@ -119,6 +178,24 @@ extern int cl_kernel_set_arg(cl_kernel,
 extern int cl_kernel_set_arg_svm_pointer(cl_kernel,
                                             uint32_t arg_index,
                                             const void *arg_value);
+/* Set an argument from the API. It goes to the calling thread's staging copy
+ * of the arguments first and is then published in the kernel object
+ */
+extern cl_int cl_kernel_stage_arg(cl_kernel k,
+                                  uint32_t arg_index,
+                                  size_t arg_size,
+                                  const void *arg_value,
+                                  cl_bool is_svm);
+
+/* Private copy of the curbe and arguments to launch the kernel from the
+ * calling thread with the arguments it set since its last launch, and the
+ * kernel object's ones for the others. It consumes the staged arguments
+ */
+extern cl_kernel cl_kernel_snapshot(cl_kernel k);
+
+/* Number of kernel code uploads alive in the process, shared BOs count once */
+extern cl_int cl_kernel_isa_upload_n(void);
+
 extern cl_int cl_kernel_set_exec_info(cl_kernel k,
                                       size_t n,
                                       const void *value);
@@ -129,6 +206,19 @@ extern int cl_get_kernel_arg_info(cl_kernel k, cl_uint arg_index,
                                   size_t param_value_size, void *param_value,
                                   size_t *param_value_size_ret);
 
+/* Choose a local size for a NULL local_work_size. It returns the tuning slot
+ * the launch must report its run time to with cl_kernel_tune_report, or -1
+ */
+extern cl_int
+cl_kernel_advise_local_sz(cl_kernel ker,
+                          cl_uint wk_dim,
+                          const size_t *global_wk_sz,
+                          size_t *local_wk_sz);
+
+/* Record the GPU run time of a tuning launch */
+extern void
+cl_kernel_tune_report(cl_kernel ker, cl_int slot, cl_ulong time);
+
 /* Compute and check the work group size from the user provided local size */
 extern cl_int
 cl_kernel_work_group_sz(cl_kernel ker,
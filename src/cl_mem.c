@@ -187,14 +187,21 @@ cl_mem_allocate(enum cl_mem_type type,
               mem->bo = svm_mem->bo;
               cl_mem_add_ref(svm_mem);
               bufCreated = 1;
-            } else if ((ALIGN((unsigned long)host_ptr, cacheline_size) == (unsigned long)host_ptr) &&
-                (ALIGN((unsigned long)sz, cacheline_size) == (unsigned long)sz)) {
+            } else if (ALIGN((unsigned long)host_ptr, 4) == (unsigned long)host_ptr) {
+              /* Wrap the pages enclosing the host range and bind the buffer at
+                 its offset in the first page. RAW surfaces only need a DWORD
+                 aligned base address and sz is already a multiple of 4, so any
+                 DWORD aligned host pointer can be used without a copy. */
               void* aligned_host_ptr = (void*)(((unsigned long)host_ptr) & (~(page_size - 1)));
-              mem->offset = host_ptr - aligned_host_ptr;
-              mem->is_userptr = 1;
-              size_t aligned_sz = ALIGN((mem->offset + sz), page_size);
+              size_t offset = host_ptr - aligned_host_ptr;
+              size_t aligned_sz = ALIGN((offset + sz), page_size);
               mem->bo = cl_buffer_alloc_userptr(bufmgr, "CL userptr memory object", aligned_host_ptr, aligned_sz, 0);
-              bufCreated = 1;
+              /* Fallback to a copied buffer if the kernel refuses the range */
+              if (mem->bo != NULL) {
+                mem->offset = offset;
+                mem->is_userptr = 1;
+                bufCreated = 1;
+              }
             }
           }
         }
@@ -726,16 +733,25 @@ cl_mem_copy_image(struct _cl_mem_image *image,
   cl_mem_unmap_auto((cl_mem)image);
 }
 
-cl_image_tiling_t cl_get_default_tiling(cl_driver drv)
+static cl_image_tiling_t
+cl_get_default_tiling(cl_driver drv)
+{
+  // FIXME, need to find out the performance diff's root cause on BDW.
+  // SKL's 3D Image can't use TILE_X, so use TILE_Y as default
+  if(cl_driver_get_ver(drv) == 8 || cl_driver_get_ver(drv) == 9)
+    return CL_TILE_Y;
+  return CL_TILE_X;
+}
+
+/* OCL_TILING=0/1/2 forces linear, X or Y tiling on every image which may be
+   tiled, bypassing the policy. Returns -1 when it is not set. */
+static int
+cl_get_forced_tiling(void)
 {
   static int initialized = 0;
-  static cl_image_tiling_t tiling = CL_TILE_X;
+  static int tiling = -1;
 
   if (!initialized) {
-    // FIXME, need to find out the performance diff's root cause on BDW.
-    // SKL's 3D Image can't use TILE_X, so use TILE_Y as default
-    if(cl_driver_get_ver(drv) == 8 || cl_driver_get_ver(drv) == 9)
-      tiling = CL_TILE_Y;
     char *tilingStr = getenv("OCL_TILING");
     if (tilingStr != NULL) {
       switch (tilingStr[0]) {
@@ -752,6 +768,49 @@ cl_image_tiling_t cl_get_default_tiling(cl_driver drv)
   return tiling;
 }
 
+/* Choose the tiling of an image which the hardware allows to be tiled, i.e.
+   not a 1D image nor an image sharing the bo of a buffer. Mapping a tiled bo
+   goes through the uncached GTT aperture and is much slower than mapping a
+   linear one, while the sampler only gains from tiling when the image spans
+   many tiles. So the memory flags decide between host and kernel friendly
+   layouts for 2D images, 3D images and arrays keep the per gen default. */
+static cl_image_tiling_t
+cl_image_choose_tiling(cl_context ctx,
+                       cl_mem_flags flags,
+                       cl_mem_object_type image_type,
+                       size_t w,
+                       size_t h,
+                       uint32_t bpp)
+{
+  const int forced = cl_get_forced_tiling();
+  const size_t row = w * bpp;
+  cl_image_tiling_t tiling;
+
+  if (forced >= 0)
+    return (cl_image_tiling_t)forced;
+
+  tiling = cl_get_default_tiling(ctx->drv);
+  if (image_type != CL_MEM_OBJECT_IMAGE2D)
+    return tiling;
+
+  /* Host pointer and host allocated images are the ones the application
+     keeps mapping, unless it told us the host never touches them. */
+  if ((flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR)) &&
+      !(flags & CL_MEM_HOST_NO_ACCESS))
+    return CL_NO_TILE;
+
+  /* Not even one page, tiling only pads it. */
+  if (row * h <= 4096)
+    return CL_NO_TILE;
+
+  /* Sampled only images gain the most from the 2D locality of TILE_Y, and
+     narrow rows would waste most of a 512 bytes wide TILE_X row. */
+  if (tiling == CL_TILE_X && ((flags & CL_MEM_READ_ONLY) || row <= 256))
+    tiling = CL_TILE_Y;
+
+  return tiling;
+}
+
 static cl_mem
 _cl_new_image_copy_from_host_ptr(cl_context ctx,
                   cl_mem_flags flags,
@@ -920,7 +979,7 @@ _cl_mem_new_image(cl_context ctx,
       tiling = CL_NO_TILE;
     } else if (cl_driver_get_ver(ctx->drv) != 6) {
       /* Pick up tiling mode (we do only linear on SNB) */
-      tiling = cl_get_default_tiling(ctx->drv);
+      tiling = cl_image_choose_tiling(ctx, flags, image_type, w, h, bpp);
     }
 
     size_t min_pitch = bpp * w;
@@ -940,7 +999,7 @@ _cl_mem_new_image(cl_context ctx,
       h = 1;
       tiling = CL_NO_TILE;
     } else if (cl_driver_get_ver(ctx->drv) != 6)
-      tiling = cl_get_default_tiling(ctx->drv);
+      tiling = cl_image_choose_tiling(ctx, flags, image_type, w, h, bpp);
 
     size_t min_pitch = bpp * w;
     if (data && pitch == 0)
@@ -1501,7 +1560,7 @@ cl_mem_delete(cl_mem mem)
     for(i=0; i<mem->mapped_ptr_sz; i++) {
       if(mem->mapped_ptr[i].ptr != NULL) {
         mem->map_ref--;
-        cl_mem_unmap_auto(mem);
+        cl_mem_unmap_range(mem, mem->mapped_ptr[i].gtt_map);
       }
     }
     assert(mem->map_ref == 0);
@@ -1510,6 +1569,10 @@ cl_mem_delete(cl_mem mem)
   if (mem->mapped_ptr)
     free(mem->mapped_ptr);
 
+  /* The commands using it hold a reference until they complete */
+  assert(mem->busy_range_n == 0);
+  cl_free(mem->busy_ranges);
+
   /* Iff we are sub, do nothing for bo release. */
   if (mem->type == CL_MEM_SUBBUFFER_TYPE) {
     struct _cl_mem_buffer* buffer = (struct _cl_mem_buffer*)mem;
@@ -2428,17 +2491,17 @@ cl_mem_unmap(cl_mem mem)
 LOCAL void*
 cl_mem_map_gtt(cl_mem mem)
 {
-  cl_buffer_map_gtt(mem->bo);
-  assert(cl_buffer_get_virtual(mem->bo));
-  mem->mapped_gtt = 1;
+  if (cl_buffer_map_gtt(mem->bo) != 0)
+    return NULL;
   return cl_buffer_get_virtual(mem->bo);
 }
 
+/* Fails when the bo does not fit in the mappable aperture */
 LOCAL void *
 cl_mem_map_gtt_unsync(cl_mem mem)
 {
-  cl_buffer_map_gtt_unsync(mem->bo);
-  assert(cl_buffer_get_virtual(mem->bo));
+  if (cl_buffer_map_gtt_unsync(mem->bo) != 0)
+    return NULL;
   return cl_buffer_get_virtual(mem->bo);
 }
 
@@ -2467,13 +2530,173 @@ cl_mem_map_auto(cl_mem mem, int write)
   }
 }
 
+LOCAL cl_mem
+cl_mem_bo_owner(cl_mem mem, size_t *offset)
+{
+  cl_mem svm;
+
+  if (mem->type == CL_MEM_SUBBUFFER_TYPE) {
+    *offset += ((struct _cl_mem_buffer *)mem)->sub_offset;
+    return (cl_mem)((struct _cl_mem_buffer *)mem)->parent;
+  }
+
+  if (mem->is_svm && mem->type != CL_MEM_SVM_TYPE) {
+    svm = cl_context_get_svm_from_ptr(mem->ctx, mem->host_ptr);
+    if (svm) {
+      *offset += (size_t)mem->host_ptr - (size_t)svm->host_ptr;
+      return svm;
+    }
+  }
+
+  /* The image covers any part of the buffer */
+  if (IS_IMAGE(mem) && cl_mem_image(mem)->buffer_1d) {
+    *offset = 0;
+    return cl_mem_bo_owner(cl_mem_image(mem)->buffer_1d, offset);
+  }
+
+  return mem;
+}
+
+LOCAL cl_int
+cl_mem_add_busy_range(cl_mem owner, size_t offset, size_t size, cl_bool write,
+                      cl_command_queue queue, cl_gpgpu gpgpu)
+{
+  cl_mem_busy_range *range;
+
+  CL_OBJECT_LOCK(owner);
+  if (owner->busy_range_n == owner->busy_range_sz) {
+    int sz = owner->busy_range_sz ? owner->busy_range_sz * 2 : 4;
+    range = cl_realloc(owner->busy_ranges, sz * sizeof(cl_mem_busy_range));
+    if (range == NULL) {
+      CL_OBJECT_UNLOCK(owner);
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+    owner->busy_ranges = range;
+    owner->busy_range_sz = sz;
+  }
+
+  range = &owner->busy_ranges[owner->busy_range_n++];
+  range->offset = offset;
+  range->size = size;
+  range->write = write;
+  range->gpgpu = gpgpu;
+  range->queue = queue;
+  CL_OBJECT_UNLOCK(owner);
+  return CL_SUCCESS;
+}
+
+LOCAL void
+cl_mem_remove_busy_ranges(cl_mem owner, cl_gpgpu gpgpu)
+{
+  int i;
+
+  CL_OBJECT_LOCK(owner);
+  for (i = 0; i < owner->busy_range_n;) {
+    if (owner->busy_ranges[i].gpgpu == gpgpu)
+      owner->busy_ranges[i] = owner->busy_ranges[--owner->busy_range_n];
+    else
+      i++;
+  }
+  CL_OBJECT_UNLOCK(owner);
+}
+
+#define CL_MEM_WAIT_RANGE_MAX 16
+
+static cl_bool
+cl_mem_range_is_waited(cl_mem_busy_range *range, size_t offset, size_t size, int write)
+{
+  if (range->offset >= offset + size || offset >= range->offset + range->size)
+    return CL_FALSE;
+  return write || range->write;
+}
+
+/* Wait for the commands writing the range, or also reading it if write */
+LOCAL void
+cl_mem_wait_range(cl_mem mem, size_t offset, size_t size, int write)
+{
+  void *bufs[CL_MEM_WAIT_RANGE_MAX];
+  cl_mem_busy_range *range;
+  cl_command_queue queue;
+  cl_mem owner = cl_mem_bo_owner(mem, &offset);
+  int i, n = 0, too_many = 0;
+
+  /* The commands may still wait in the batch of their queue. Flushing takes
+     the batch lock, so the owner one is dropped first. A flushed queue has an
+     empty batch and is not picked again. */
+  for (;;) {
+    queue = NULL;
+    CL_OBJECT_LOCK(owner);
+    for (i = 0; i < owner->busy_range_n; i++) {
+      range = &owner->busy_ranges[i];
+      if (cl_mem_range_is_waited(range, offset, size, write) && range->queue->batch_num) {
+        queue = range->queue;
+        cl_command_queue_add_ref(queue);
+        break;
+      }
+    }
+    CL_OBJECT_UNLOCK(owner);
+    if (queue == NULL)
+      break;
+    cl_command_queue_flush_batch(queue);
+    cl_command_queue_delete(queue);
+  }
+
+  CL_OBJECT_LOCK(owner);
+  for (i = 0; i < owner->busy_range_n; i++) {
+    range = &owner->busy_ranges[i];
+    if (!cl_mem_range_is_waited(range, offset, size, write))
+      continue;
+    if (n < CL_MEM_WAIT_RANGE_MAX)
+      bufs[n++] = cl_gpgpu_ref_batch_buf(range->gpgpu);
+    else
+      too_many = 1;
+  }
+  CL_OBJECT_UNLOCK(owner);
+
+  for (i = 0; i < n; i++) {
+    cl_gpgpu_sync(bufs[i]);
+    cl_gpgpu_unref_batch_buf(bufs[i]);
+  }
+  if (too_many)
+    cl_buffer_wait_rendering(owner->bo);
+}
+
+/* Waiting for the whole bo would also wait for the commands using other
+   ranges of it, for example the other slices of a ring buffer. */
+LOCAL void*
+cl_mem_map_range(cl_mem mem, size_t offset, size_t size, int write, cl_bool *gtt)
+{
+  void *ptr;
+
+  *gtt = CL_FALSE;
+  cl_mem_wait_range(mem, offset, size, write);
+  /* The range is idle, the CPU can use the user memory right away */
+  if (mem->is_userptr)
+    return mem->host_ptr;
+  if (!cl_buffer_is_busy(mem->bo))
+    return cl_mem_map_auto(mem, write);
+
+  /* A CPU map would wait for the other commands, the GTT one does not. It
+     fails for the bos out of the mappable aperture, which wait then. */
+  if ((ptr = cl_mem_map_gtt_unsync(mem)) == NULL)
+    return cl_mem_map_auto(mem, write);
+  *gtt = CL_TRUE;
+  return ptr;
+}
+
+LOCAL cl_int
+cl_mem_unmap_range(cl_mem mem, cl_bool gtt)
+{
+  if (gtt)
+    return cl_mem_unmap_gtt(mem);
+  return cl_mem_unmap_auto(mem);
+}
+
 LOCAL cl_int
 cl_mem_unmap_auto(cl_mem mem)
 {
-  if (mem->mapped_gtt == 1) {
+  if (IS_IMAGE(mem) && cl_mem_image(mem)->tiling != CL_NO_TILE)
     cl_buffer_unmap_gtt(mem->bo);
-    mem->mapped_gtt = 0;
-  }
   else if (!mem->is_userptr)
     cl_buffer_unmap(mem->bo);
   return CL_SUCCESS;
@@ -2690,7 +2913,7 @@ error:
 }
 
 static cl_int
-get_mapped_address(cl_mem mem)
+get_mapped_address(cl_mem mem, uint8_t gtt_map)
 {
   cl_int slot = -1;
   if (!mem->mapped_ptr_sz) {
@@ -2698,7 +2921,7 @@ get_mapped_address(cl_mem mem)
     mem->mapped_ptr = (cl_mapped_ptr *)malloc(
         sizeof(cl_mapped_ptr) * mem->mapped_ptr_sz);
     if (!mem->mapped_ptr) {
-      cl_mem_unmap_auto(mem);
+      cl_mem_unmap_range(mem, gtt_map);
       return slot;
     }
     memset(mem->mapped_ptr, 0, mem->mapped_ptr_sz * sizeof(cl_mapped_ptr));
@@ -2715,7 +2938,7 @@ get_mapped_address(cl_mem mem)
       cl_mapped_ptr *new_ptr = (cl_mapped_ptr *)malloc(
           sizeof(cl_mapped_ptr) * mem->mapped_ptr_sz * 2);
       if (!new_ptr) {
-        cl_mem_unmap_auto(mem);
+        cl_mem_unmap_range(mem, gtt_map);
         return slot;
       }
       memset(new_ptr, 0, 2 * mem->mapped_ptr_sz * sizeof(cl_mapped_ptr));
@@ -2752,7 +2975,7 @@ cl_mem_record_map_mem_for_kernel(cl_mem mem, void *ptr, void **mem_ptr, size_t o
     *mem_ptr = ptr;
   }
   /* Record the mapped address. */
-  slot = get_mapped_address(mem);
+  slot = get_mapped_address(mem, 0);
   if (slot == -1) {
     err = CL_OUT_OF_HOST_MEMORY;
     goto error;
@@ -2780,7 +3003,8 @@ error:
 
 LOCAL cl_int
 cl_mem_record_map_mem(cl_mem mem, void *ptr, void **mem_ptr, size_t offset,
-                      size_t size, const size_t *origin, const size_t *region)
+                      size_t size, const size_t *origin, const size_t *region,
+                      uint8_t gtt_map)
 {
   // TODO: Need to add MT safe logic.
 
@@ -2802,7 +3026,7 @@ cl_mem_record_map_mem(cl_mem mem, void *ptr, void **mem_ptr, size_t offset,
     *mem_ptr = ptr;
   }
   /* Record the mapped address. */
-  slot = get_mapped_address(mem);
+  slot = get_mapped_address(mem, gtt_map);
   if (slot == -1) {
     err = CL_OUT_OF_HOST_MEMORY;
     goto error;
@@ -2810,6 +3034,7 @@ cl_mem_record_map_mem(cl_mem mem, void *ptr, void **mem_ptr, size_t offset,
   mem->mapped_ptr[slot].ptr = *mem_ptr;
   mem->mapped_ptr[slot].v_ptr = ptr;
   mem->mapped_ptr[slot].size = size;
+  mem->mapped_ptr[slot].gtt_map = gtt_map;
   if(origin) {
     assert(region);
     mem->mapped_ptr[slot].origin[0] = origin[0];
@@ -63,6 +63,7 @@ typedef struct _cl_mapped_ptr {
   size_t region[3];  /* mapped region */
   cl_mem tmp_ker_buf;       /* this object is tmp buffer for OCL kernel copying */
   uint8_t ker_write_map;    /* this flag is used to indicate CL_MAP_WRITE for OCL kernel copying */
+  uint8_t gtt_map;          /* this mapping is a GTT one, unmap it in GTT mode */
 }cl_mapped_ptr;
 
 typedef struct _cl_mem_dstr_cb {
@@ -72,6 +73,15 @@ typedef struct _cl_mem_dstr_cb {
 } _cl_mem_dstr_cb;
 typedef _cl_mem_dstr_cb* cl_mem_dstr_cb;
 
+/* A range of a bo that a GPU command may access until it completes */
+typedef struct _cl_mem_busy_range {
+  size_t offset;            /* Start in the memory object owning the bo */
+  size_t size;
+  cl_bool write;            /* The command may write the range */
+  cl_gpgpu gpgpu;           /* The command, the range is removed when it completes */
+  cl_command_queue queue;   /* Its queue, to flush the batch holding it */
+} cl_mem_busy_range;
+
 /* Used for buffers and images */
 enum cl_mem_type {
   CL_MEM_BUFFER_TYPE,
@@ -96,7 +106,6 @@ typedef  struct _cl_mem {
   cl_mapped_ptr* mapped_ptr;/* Store the mapped addresses and size by caller. */
   int mapped_ptr_sz;        /* The array size of mapped_ptr. */
   int map_ref;              /* The mapped count. */
-  uint8_t mapped_gtt;       /* This object has mapped gtt, for unmap. */
   list_head dstr_cb_head;   /* All destroy callbacks. */
   uint8_t is_userptr;       /* CL_MEM_USE_HOST_PTR is enabled */
   cl_bool is_svm;           /* This object  is svm */
@@ -104,6 +113,9 @@ typedef  struct _cl_mem {
 
   uint8_t cmrt_mem_type;    /* CmBuffer, CmSurface2D, ... */
   void* cmrt_mem;
+  cl_mem_busy_range *busy_ranges; /* Ranges in use by GPU commands, only on the bo owner */
+  int busy_range_n;         /* Used ranges in busy_ranges. */
+  int busy_range_sz;        /* The array size of busy_ranges. */
 } _cl_mem;
 
 #define CL_OBJECT_MEM_MAGIC 0x381a27b9ee6504dfLL
@@ -317,6 +329,26 @@ extern void *cl_mem_map_auto(cl_mem, int);
 /* Unmap a memory object - tiled images are unmapped in GTT mode */
 extern cl_int cl_mem_unmap_auto(cl_mem);
 
+/* The memory object owning the bo of mem, with offset converted to it */
+extern cl_mem cl_mem_bo_owner(cl_mem mem, size_t *offset);
+
+/* Record that a GPU command uses a range of the bo owner, until it is removed */
+extern cl_int cl_mem_add_busy_range(cl_mem owner, size_t offset, size_t size, cl_bool write,
+                                    cl_command_queue queue, cl_gpgpu gpgpu);
+
+/* Remove the ranges used by the GPU command */
+extern void cl_mem_remove_busy_ranges(cl_mem owner, cl_gpgpu gpgpu);
+
+/* Wait for the GPU commands conflicting with a range of a buffer */
+extern void cl_mem_wait_range(cl_mem mem, size_t offset, size_t size, int write);
+
+/* Map a buffer once the GPU commands conflicting with a range of it are done,
+ * gtt tells if the map is a GTT one */
+extern void *cl_mem_map_range(cl_mem mem, size_t offset, size_t size, int write, cl_bool *gtt);
+
+/* Unmap a buffer mapped by cl_mem_map_range */
+extern cl_int cl_mem_unmap_range(cl_mem mem, cl_bool gtt);
+
 /* Pin/unpin the buffer in memory (you must be root) */
 extern cl_int cl_mem_pin(cl_mem);
 extern cl_int cl_mem_unpin(cl_mem);
@@ -368,7 +400,8 @@ extern cl_mem cl_mem_new_image_from_fd(cl_context ctx,
                                        cl_int *errcode);
 
 extern cl_int cl_mem_record_map_mem(cl_mem mem, void *ptr, void **mem_ptr, size_t offset,
-                      size_t size, const size_t *origin, const size_t *region);
+                      size_t size, const size_t *origin, const size_t *region,
+                      uint8_t gtt_map);
 
 extern cl_int cl_mem_record_map_mem_for_kernel(cl_mem mem, void *ptr, void **mem_ptr, size_t offset,
                       size_t size, const size_t *origin, const size_t *region, cl_mem tmp_ker_buf, uint8_t write_map);
@@ -89,7 +89,6 @@ cl_program_delete(cl_program p)
   else
 #endif
   {
-    cl_free(p->bin);               /* Free the blob */
     for (i = 0; i < p->ker_n; ++i) /* Free the kernels */
       cl_kernel_delete(p->ker[i]);
     cl_free(p->ker);
@@ -153,32 +152,60 @@ static cl_int
 cl_program_load_gen_program(cl_program p)
 {
   cl_int err = CL_SUCCESS;
-  uint32_t i;
 
   assert(p->opaque != NULL);
   p->ker_n = interp_program_get_kernel_num(p->opaque);
 
-  /* Allocate the kernel array */
+  /* Allocate the kernel array, the kernels themselves are set up the first
+   * time they are requested, which is also when the compiler generates their
+   * code if it deferred it */
   TRY_ALLOC (p->ker, CALLOC_ARRAY(cl_kernel, p->ker_n));
 
-  for (i = 0; i < p->ker_n; ++i) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    assert(opaque != NULL);
-    TRY_ALLOC (p->ker[i], cl_kernel_new(p));
-    cl_kernel_setup(p->ker[i], opaque);
-  }
-
 error:
   return err;
 }
 
+LOCAL cl_kernel
+cl_program_get_kernel(cl_program p, uint32_t index, cl_int *errcode_ret)
+{
+  cl_kernel k = NULL;
+  cl_int err = CL_SUCCESS;
+
+  assert(index < p->ker_n);
+  CL_OBJECT_LOCK(p);
+  if (p->ker[index] == NULL) {
+    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, index);
+    if (UNLIKELY(opaque == NULL)) {
+      DEBUGP(DL_ERROR, "failed to generate the code of kernel %s\n",
+             interp_program_get_kernel_name(p->opaque, index));
+      /* The code generation deferred from the build failed, report it like
+         a build failure */
+      if (p->build_log && p->build_log_sz < p->build_log_max_sz)
+        p->build_log_sz += interp_program_take_lazy_log(p->opaque, p->build_log + p->build_log_sz,
+                                                        p->build_log_max_sz - p->build_log_sz);
+      err = CL_INVALID_PROGRAM_EXECUTABLE;
+    } else if ((k = cl_kernel_new(p)) == NULL) {
+      err = CL_OUT_OF_HOST_MEMORY;
+    } else {
+      cl_kernel_setup(k, opaque);
+      p->ker[index] = k;
+    }
+  }
+  k = p->ker[index];
+  CL_OBJECT_UNLOCK(p);
+
+  if (errcode_ret)
+    *errcode_ret = err;
+  return k;
+}
+
 #define BINARY_HEADER_LENGTH 5
 
 static const unsigned char binary_type_header[BHI_MAX][BINARY_HEADER_LENGTH]=  \
                                               {{'B','C', 0xC0, 0xDE},
                                                {1, 'B', 'C', 0xC0, 0xDE},
                                                {2, 'B', 'C', 0xC0, 0xDE},
-                                               {1, 'G','E', 'N', 'C'},
+                                               {GBE_GEN_BINARY_VERSION, 'G','E', 'N', 'C'},
                                                {'C','I', 'S', 'A'},
                                                };
 
@@ -546,8 +573,6 @@ LOCAL cl_int
 cl_program_build(cl_program p, const char *options)
 {
   cl_int err = CL_SUCCESS;
-  int i = 0;
-  int copyed = 0;
 
   if (CL_OBJECT_GET_REF(p) > 1) {
     err = CL_INVALID_OPERATION;
@@ -633,20 +658,7 @@ cl_program_build(cl_program p, const char *options)
   }
   p->binary_type = CL_PROGRAM_BINARY_TYPE_EXECUTABLE;
 
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    p->bin_sz += interp_kernel_get_code_size(opaque);
-  }
-
-  TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    size_t sz = interp_kernel_get_code_size(opaque);
-
-    memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
-    copyed += sz;
-  }
-  uint32_t ocl_version = interp_kernel_get_ocl_version(interp_program_get_kernel(p->opaque, 0));
+  uint32_t ocl_version = interp_program_get_ocl_version(p->opaque);
   if (ocl_version >= 200 && (err = get_program_global_data(p)) != CL_SUCCESS)
     goto error;
 
@@ -669,7 +681,6 @@ cl_program_link(cl_context            context,
   cl_program p = NULL;
   cl_int err = CL_SUCCESS;
   cl_int i = 0;
-  int copyed = 0;
   cl_bool ret = 0;
   int avialable_program = 0;
   //Although we don't use options, but still need check options
@@ -742,21 +753,7 @@ cl_program_link(cl_context            context,
   /* Create all the kernels */
   TRY (cl_program_load_gen_program, p);
 
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    p->bin_sz += interp_kernel_get_code_size(opaque);
-  }
-
-  TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    size_t sz = interp_kernel_get_code_size(opaque);
-
-    memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
-    copyed += sz;
-  }
-
-  uint32_t ocl_version = interp_kernel_get_ocl_version(interp_program_get_kernel(p->opaque, 0));
+  uint32_t ocl_version = interp_program_get_ocl_version(p->opaque);
   if (ocl_version >= 200 && (err = get_program_global_data(p)) != CL_SUCCESS)
     goto error;
 
@@ -917,20 +914,21 @@ cl_program_create_kernel(cl_program p, const char *name, cl_int *errcode_ret)
 
   /* Find the program first */
   for (i = 0; i < p->ker_n; ++i) {
-    assert(p->ker[i]);
-    const char *ker_name = cl_kernel_get_name(p->ker[i]);
-    if (ker_name != NULL && strcmp(ker_name, name) == 0) {
-      from = p->ker[i];
+    const char *ker_name = interp_program_get_kernel_name(p->opaque, i);
+    if (ker_name != NULL && strcmp(ker_name, name) == 0)
       break;
-    }
   }
 
   /* We were not able to find this named kernel */
-  if (UNLIKELY(from == NULL)) {
+  if (UNLIKELY(i == p->ker_n)) {
     err = CL_INVALID_KERNEL_NAME;
     goto error;
   }
 
+  from = cl_program_get_kernel(p, i, &err);
+  if (UNLIKELY(from == NULL))
+    goto error;
+
   TRY_ALLOC(to, cl_kernel_dup(from));
 
 exit:
@@ -946,13 +944,19 @@ error:
 LOCAL cl_int
 cl_program_create_kernels_in_program(cl_program p, cl_kernel* ker)
 {
+  cl_int err = CL_SUCCESS;
   int i = 0;
 
   if(ker == NULL)
     return CL_SUCCESS;
 
   for (i = 0; i < p->ker_n; ++i) {
-    TRY_ALLOC_NO_ERR(ker[i], cl_kernel_dup(p->ker[i]));
+    cl_kernel from = cl_program_get_kernel(p, i, &err);
+    if (UNLIKELY(from == NULL)) {
+      ker[i] = NULL;
+      goto error;
+    }
+    TRY_ALLOC_NO_ERR(ker[i], cl_kernel_dup(from));
   }
 
   return CL_SUCCESS;
@@ -963,7 +967,7 @@ error:
     ker[i--] = NULL;
   } while(i > 0);
 
-  return CL_OUT_OF_HOST_MEMORY;
+  return err == CL_SUCCESS ? CL_OUT_OF_HOST_MEMORY : err;
 }
 
 LOCAL void
@@ -978,7 +982,7 @@ cl_program_get_kernel_names(cl_program p, size_t size, char *names, size_t *size
     return;
   }
 
-  ker_name = cl_kernel_get_name(p->ker[0]);
+  ker_name = interp_program_get_kernel_name(p->opaque, 0);
   if (ker_name != NULL)
     len = strlen(ker_name);
   else
@@ -995,7 +999,7 @@ cl_program_get_kernel_names(cl_program p, size_t size, char *names, size_t *size
   if(size_ret) *size_ret = len + 1;  //add NULL
 
   for (i = 1; i < p->ker_n; ++i) {
-    ker_name = cl_kernel_get_name(p->ker[i]);
+    ker_name = interp_program_get_kernel_name(p->opaque, i);
     if (ker_name != NULL)
       len = strlen(ker_name);
     else
@@ -20,6 +20,9 @@
 #ifndef __CL_UTILS_H__
 #define __CL_UTILS_H__
 #include "CL/cl.h"
+#if !defined(__i386__) && !defined(__x86_64__)
+#include <sched.h>
+#endif
 
 /* INLINE is forceinline */
 #define INLINE __attribute__((always_inline)) inline
@@ -359,6 +362,20 @@ static INLINE int atomic_read(atomic_t *v) {
 static INLINE int atomic_inc(atomic_t *v) { return atomic_add(v, 1); }
 static INLINE int atomic_dec(atomic_t *v) { return atomic_add(v, -1); }
 
+/* Busy wait hint. Without a pause instruction, give the CPU away instead */
+static INLINE void cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause" ::: "memory");
+#else
+  sched_yield();
+#endif
+}
+
+/* Replace *v by n if it is still o. Returns non zero on success */
+static INLINE int atomic_cmpxchg_ptr(void * volatile *v, void *o, void *n) {
+  return __sync_bool_compare_and_swap(v, o, n);
+}
+
 /* Define one list node. */
 typedef struct list_node {
   struct list_node *n;
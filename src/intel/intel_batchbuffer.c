@@ -58,27 +58,22 @@ LOCAL int
 intel_batchbuffer_reset(intel_batchbuffer_t *batch, size_t sz)
 {
   if (batch->buffer != NULL) {
-    dri_bo_unreference(batch->buffer);
+    intel_driver_ring_put(batch->intel, &batch->intel->batch_ring, batch->buffer);
     batch->buffer = NULL;
     batch->last_bo = NULL;
   }
 
-  batch->buffer = dri_bo_alloc(batch->intel->bufmgr,
-                               "batch buffer",
-                               sz,
-                               64);
-  if (!batch->buffer || (dri_bo_map(batch->buffer, 1) != 0)) {
-    if (batch->buffer)
-      dri_bo_unreference(batch->buffer);
-    batch->buffer = NULL;
+  batch->buffer = intel_driver_ring_get(batch->intel, &batch->intel->batch_ring,
+                                        "batch buffer", sz, 64);
+  if (!batch->buffer)
     return -1;
-  }
   batch->map = (uint8_t*) batch->buffer->virtual;
   batch->size = sz;
   batch->ptr = batch->map;
   batch->atomic = 0;
   batch->last_bo = batch->buffer;
   batch->enable_slm = 0;
+  batch->chain_next = NULL;
   return 0;
 }
 
@@ -94,13 +89,49 @@ intel_batchbuffer_terminate(intel_batchbuffer_t *batch)
 {
   assert(batch->buffer);
 
-  if (batch->map) {
-    dri_bo_unmap(batch->buffer);
-    batch->map = NULL;
+  /* The batch is done when its gpgpu is deleted, reuse it */
+  intel_driver_ring_put(batch->intel, &batch->intel->batch_ring, batch->buffer);
+  batch->map = NULL;
+  batch->buffer = NULL;
+}
+
+/* Gen8+ only: the batch will end with a jump into next instead of a
+   MI_BATCH_BUFFER_END, and flushing it also submits next. */
+LOCAL void
+intel_batchbuffer_chain(intel_batchbuffer_t *batch, intel_batchbuffer_t *next)
+{
+  assert(batch->chain_next == NULL);
+  assert(next->buffer && next->ptr);
+  batch->chain_next = next;
+}
+
+/* Terminate the batch and return its size. The end is kept qword aligned. */
+static uint32_t
+intel_batchbuffer_close(intel_batchbuffer_t *batch)
+{
+  uint32_t used;
+
+  if (((batch->ptr - batch->map) & 4) == 0) {
+    *(uint32_t*) batch->ptr = 0;
+    batch->ptr += 4;
   }
 
-  dri_bo_unreference(batch->buffer);
-  batch->buffer = NULL;
+  if (batch->chain_next) {
+    /* 3 dwords, the padding above is right for it too */
+    *(uint32_t*)batch->ptr = MI_BATCH_BUFFER_START_GEN8;
+    batch->ptr += 4;
+    intel_batchbuffer_emit_reloc(batch, batch->chain_next->buffer,
+                                 I915_GEM_DOMAIN_COMMAND, 0, 0);
+    intel_batchbuffer_emit_dword(batch, 0);
+  } else {
+    *(uint32_t*)batch->ptr = MI_BATCH_BUFFER_END;
+    batch->ptr += 4;
+  }
+
+  used = batch->ptr - batch->map;
+  dri_bo_unmap(batch->buffer);
+  batch->ptr = batch->map = NULL;
+  return used;
 }
 
 LOCAL int
@@ -108,22 +139,21 @@ intel_batchbuffer_flush(intel_batchbuffer_t *batch)
 {
   uint32_t used = batch->ptr - batch->map;
   int is_locked = batch->intel->locked;
+  intel_batchbuffer_t *chained, *next;
   int err = 0;
 
   if (used == 0)
     return 0;
 
-  if ((used & 4) == 0) {
-    *(uint32_t*) batch->ptr = 0;
-    batch->ptr += 4;
+  /* The chained batches are validated through the relocations of the jumps */
+  used = intel_batchbuffer_close(batch);
+  for (chained = batch->chain_next; chained; chained = chained->chain_next)
+    intel_batchbuffer_close(chained);
+  for (chained = batch; chained; chained = next) {
+    next = chained->chain_next;
+    chained->chain_next = NULL;
   }
 
-  *(uint32_t*)batch->ptr = MI_BATCH_BUFFER_END;
-  batch->ptr += 4;
-  used = batch->ptr - batch->map;
-  dri_bo_unmap(batch->buffer);
-  batch->ptr = batch->map = NULL;
-
   if (!is_locked)
     intel_driver_lock_hardware(batch->intel);
 
@@ -87,6 +87,9 @@ typedef struct intel_batchbuffer
    *  flag when call exec. */
   uint8_t enable_slm;
   int atomic;
+  /** Batch the hardware jumps into at the end of this one, they are
+   *  submitted together when this one is flushed. */
+  struct intel_batchbuffer *chain_next;
 } intel_batchbuffer_t;
 
 extern intel_batchbuffer_t* intel_batchbuffer_new(struct intel_driver*);
@@ -99,6 +102,7 @@ extern void intel_batchbuffer_emit_reloc(intel_batchbuffer_t*,
 extern void intel_batchbuffer_init(intel_batchbuffer_t*, struct intel_driver*);
 extern void intel_batchbuffer_terminate(intel_batchbuffer_t*);
 extern int intel_batchbuffer_flush(intel_batchbuffer_t*);
+extern void intel_batchbuffer_chain(intel_batchbuffer_t*, intel_batchbuffer_t *next);
 extern int intel_batchbuffer_reset(intel_batchbuffer_t*, size_t sz);
 
 static INLINE uint32_t
@@ -177,6 +177,7 @@ intel_driver_init(intel_driver_t *driver, int dev_fd)
 driver->fd = dev_fd;
 driver->locked = 0;
 pthread_mutex_init(&driver->ctxmutex, NULL);
+pthread_mutex_init(&driver->ring_lock, NULL);
 
 if (!intel_driver_memman_init(driver)) return 0;
 if (!intel_driver_context_init(driver)) return 0;
@@ -396,6 +397,7 @@ LOCAL int
 intel_driver_terminate(intel_driver_t *driver)
 {
 pthread_mutex_destroy(&driver->ctxmutex);
+pthread_mutex_destroy(&driver->ring_lock);
 
 if(driver->need_close) {
   close(driver->fd);
@@ -421,6 +423,86 @@ driver->locked = 0;
 PPTHREAD_MUTEX_UNLOCK(driver);
 }
 
+LOCAL drm_intel_bo*
+intel_driver_ring_get(intel_driver_t *driver, intel_bo_ring_t *ring,
+                      const char *name, uint32_t sz, uint32_t align)
+{
+  drm_intel_bo *bo = NULL;
+  int i;
+
+  pthread_mutex_lock(&driver->ring_lock);
+  if (sz > ring->peak)
+    ring->peak = sz;
+  for (i = 0; i < INTEL_BO_RING_N; i++) {
+    if (ring->bo[i] && ring->bo[i]->size >= sz && !drm_intel_bo_busy(ring->bo[i])) {
+      bo = ring->bo[i];
+      ring->bo[i] = NULL;
+      break;
+    }
+  }
+  /* Allocate for the peak, so that the buffer fits the next big ones too */
+  sz = ring->peak;
+  pthread_mutex_unlock(&driver->ring_lock);
+
+  if (bo) {
+    /* Forget the relocations of the last use */
+    drm_intel_gem_bo_clear_relocs(bo, 0);
+  } else {
+    bo = drm_intel_bo_alloc(driver->bufmgr, name, sz, align);
+    if (bo == NULL)
+      return NULL;
+  }
+
+  if (drm_intel_bo_map(bo, 1) != 0) {
+    drm_intel_bo_unreference(bo);
+    return NULL;
+  }
+  return bo;
+}
+
+LOCAL void
+intel_driver_ring_put(intel_driver_t *driver, intel_bo_ring_t *ring, drm_intel_bo *bo)
+{
+  drm_intel_bo *old = NULL;
+  int i;
+
+  if (bo->virtual)
+    drm_intel_bo_unmap(bo);
+
+  pthread_mutex_lock(&driver->ring_lock);
+  /* A buffer too small for the peak would never be picked again */
+  if (bo->size < ring->peak) {
+    old = bo;
+  } else {
+    for (i = 0; i < INTEL_BO_RING_N; i++) {
+      if (ring->bo[i] == NULL)
+        break;
+    }
+    if (i == INTEL_BO_RING_N) {
+      i = ring->next;
+      ring->next = (ring->next + 1) % INTEL_BO_RING_N;
+      old = ring->bo[i];
+    }
+    ring->bo[i] = bo;
+  }
+  pthread_mutex_unlock(&driver->ring_lock);
+
+  if (old)
+    drm_intel_bo_unreference(old);
+}
+
+static void
+intel_driver_ring_clear(intel_bo_ring_t *ring)
+{
+  int i;
+
+  for (i = 0; i < INTEL_BO_RING_N; i++) {
+    if (ring->bo[i])
+      drm_intel_bo_unreference(ring->bo[i]);
+    ring->bo[i] = NULL;
+  }
+}
+
 LOCAL dri_bo*
 intel_driver_share_buffer_from_name(intel_driver_t *driver, const char *sname, uint32_t name)
 {
@@ -481,6 +563,8 @@ cl_intel_driver_delete(intel_driver_t *driver)
 if (driver == NULL)
   return;
 intel_gpgpu_delete_all(driver);
+intel_driver_ring_clear(&driver->batch_ring);
+intel_driver_ring_clear(&driver->aux_ring);
 intel_driver_context_destroy(driver);
 intel_driver_close(driver);
 intel_driver_terminate(driver);
@@ -1071,6 +1155,7 @@ cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) drm_int
   cl_buffer_subdata = (cl_buffer_subdata_cb *) drm_intel_bo_subdata;
   cl_buffer_get_subdata = (cl_buffer_get_subdata_cb *) drm_intel_bo_get_subdata;
   cl_buffer_wait_rendering = (cl_buffer_wait_rendering_cb *) drm_intel_bo_wait_rendering;
+  cl_buffer_is_busy = (cl_buffer_is_busy_cb *) drm_intel_bo_busy;
   cl_buffer_get_fd = (cl_buffer_get_fd_cb *) drm_intel_bo_gem_export_to_prime;
   cl_buffer_get_tiling_align = (cl_buffer_get_tiling_align_cb *)intel_buffer_get_tiling_align;
   cl_buffer_get_buffer_from_fd = (cl_buffer_get_buffer_from_fd_cb *) intel_share_buffer_from_fd;
@@ -61,6 +61,7 @@
 
 #define MI_NOOP                                 (CMD_MI | 0)
 #define MI_BATCH_BUFFER_END                     (CMD_MI | (0xA << 23))
+#define MI_BATCH_BUFFER_START_GEN8              (CMD_MI | (0x31 << 23) | (1 << 8) | (3 - 2))
 
 #define XY_COLOR_BLT_CMD                        (CMD_2D | (0x50 << 22) | 0x04)
 #define XY_COLOR_BLT_WRITE_ALPHA                (1 << 21)
@@ -73,6 +74,16 @@
 
 struct dri_state;
 struct intel_gpgpu_node;
+
+/* Idle buffers kept for the next gpgpus, to save their allocation and keep
+ * their CPU mapping */
+#define INTEL_BO_RING_N 8
+typedef struct intel_bo_ring
+{
+  drm_intel_bo *bo[INTEL_BO_RING_N];
+  uint32_t next;                    /* Slot to recycle first when all are used */
+  uint32_t peak;                    /* Biggest size asked so far */
+} intel_bo_ring_t;
 typedef struct _XDisplay Display;
 
 typedef struct intel_driver
@@ -91,6 +102,9 @@ typedef struct intel_driver
   struct dri_state *dri_ctx;
   struct intel_gpgpu_node *gpgpu_list;
   int atomic_test_result;
+  pthread_mutex_t ring_lock;
+  intel_bo_ring_t batch_ring;       /* Batch buffers */
+  intel_bo_ring_t aux_ring;         /* Surface heap, curbe, IDRT and sampler states */
 } intel_driver_t;
 
 #define SET_BLOCKED_SIGSET(DRIVER)   do {                     \
@@ -122,6 +136,12 @@ typedef struct intel_driver
 extern void intel_driver_lock_hardware(intel_driver_t*);
 extern void intel_driver_unlock_hardware(intel_driver_t*);
 
+/* Get a mapped buffer of at least sz bytes, an idle one of the ring if any */
+extern drm_intel_bo* intel_driver_ring_get(intel_driver_t*, intel_bo_ring_t*,
+                                           const char *name, uint32_t sz, uint32_t align);
+/* Give a buffer back to the ring, it must not be used by the GPU anymore */
+extern void intel_driver_ring_put(intel_driver_t*, intel_bo_ring_t*, drm_intel_bo*);
+
 /* methods working in shared mode */
 extern dri_bo* intel_driver_share_buffer(intel_driver_t*, const char *sname, uint32_t name);
 extern uint32_t intel_driver_shared_name(intel_driver_t*, dri_bo*);
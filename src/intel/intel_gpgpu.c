@@ -143,7 +143,7 @@ intel_gpgpu_delete_finished(intel_gpgpu_t *gpgpu)
   if(gpgpu->printf_b.bo)
     drm_intel_bo_unreference(gpgpu->printf_b.bo);
   if (gpgpu->aux_buf.bo)
-    drm_intel_bo_unreference(gpgpu->aux_buf.bo);
+    intel_driver_ring_put(gpgpu->drv, &gpgpu->drv->aux_ring, gpgpu->aux_buf.bo);
   if (gpgpu->perf_b.bo)
     drm_intel_bo_unreference(gpgpu->perf_b.bo);
   if (gpgpu->stack_b.bo)
@@ -877,6 +877,22 @@ intel_gpgpu_batch_reset(intel_gpgpu_t *gpgpu, size_t sz)
   return intel_batchbuffer_reset(gpgpu->batch, sz);
 }
 
+/* The command parser of Gen7 kernels rejects chained batch buffers */
+static int
+intel_gpgpu_chain_gen7(intel_gpgpu_t *gpgpu, intel_gpgpu_t *next)
+{
+  return -1;
+}
+
+static int
+intel_gpgpu_chain_gen8(intel_gpgpu_t *gpgpu, intel_gpgpu_t *next)
+{
+  if (!gpgpu->batch->ptr || !next->batch->ptr)
+    return -1;
+  intel_batchbuffer_chain(gpgpu->batch, next->batch);
+  return 0;
+}
+
 static int
 intel_gpgpu_flush(intel_gpgpu_t *gpgpu)
 {
@@ -941,7 +957,7 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
   /* Set the auxiliary buffer*/
   uint32_t size_aux = 0;
   if(gpgpu->aux_buf.bo)
-    dri_bo_unreference(gpgpu->aux_buf.bo);
+    intel_driver_ring_put(gpgpu->drv, &gpgpu->drv->aux_ring, gpgpu->aux_buf.bo);
   gpgpu->aux_buf.bo = NULL;
 
   /* begin with surface heap to make sure it's page aligned,
@@ -974,12 +990,10 @@ intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
   /* make sure aux buffer is page aligned */
   size_aux = ALIGN(size_aux, 4096);
 
-  bo = dri_bo_alloc(gpgpu->drv->bufmgr, "AUX_BUFFER", size_aux, 4096);
+  bo = intel_driver_ring_get(gpgpu->drv, &gpgpu->drv->aux_ring, "AUX_BUFFER", size_aux, 4096);
 
-  if (!bo || dri_bo_map(bo, 1) != 0) {
+  if (!bo) {
     fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
-    if (bo)
-      dri_bo_unreference(bo);
     if (profiling && gpgpu->time_stamp_b.bo)
       dri_bo_unreference(gpgpu->time_stamp_b.bo);
     gpgpu->time_stamp_b.bo = NULL;
@@ -1753,6 +1767,7 @@ intel_gpgpu_build_idrt_gen8(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   desc->desc4.binding_table_pointer = 0;
   desc->desc5.curbe_read_len = kernel->curbe_sz / 32;
   desc->desc5.curbe_read_offset = 0;
+  desc->desc7.cross_thread_curbe_read_len = kernel->cross_curbe_sz / 32;
 
   /* Barriers / SLM are automatically handled on Gen7+ */
   size_t slm_sz = kernel->slm_sz;
@@ -1794,6 +1809,7 @@ intel_gpgpu_build_idrt_gen9(intel_gpgpu_t *gpgpu, cl_gpgpu_kernel *kernel)
   desc->desc4.binding_table_pointer = 0;
   desc->desc5.curbe_read_len = kernel->curbe_sz / 32;
   desc->desc5.curbe_read_offset = 0;
+  desc->desc7.cross_thread_curbe_read_len = kernel->cross_curbe_sz / 32;
 
   /* Barriers / SLM are automatically handled on Gen7+ */
   size_t slm_sz = kernel->slm_sz;
@@ -1866,9 +1882,11 @@ intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t
   curbe = (unsigned char *) (gpgpu->aux_buf.bo->virtual + gpgpu->aux_offset.curbe_offset);
   memcpy(curbe, data, size);
 
-  /* Now put all the relocations for our flat address space */
-  for (i = 0; i < k->thread_n; ++i)
-    for (j = 0; j < gpgpu->binded_n; ++j) {
+  /* Now put all the relocations for our flat address space. Pointers in the
+   * cross thread curbe are read by all the threads and only patched once */
+  for (j = 0; j < gpgpu->binded_n; ++j) {
+    const uint32_t n = gpgpu->binded_offset[j] < k->cross_curbe_sz ? 1 : k->thread_n;
+    for (i = 0; i < n; ++i) {
       *(size_t *)(curbe + gpgpu->binded_offset[j]+i*k->curbe_sz) = gpgpu->binded_buf[j]->offset64 + gpgpu->target_buf_offset[j];
       drm_intel_bo_emit_reloc(gpgpu->aux_buf.bo,
                               gpgpu->aux_offset.curbe_offset + gpgpu->binded_offset[j]+i*k->curbe_sz,
@@ -1877,6 +1895,7 @@ intel_gpgpu_upload_curbes_gen8(intel_gpgpu_t *gpgpu, const void* data, uint32_t
                               I915_GEM_DOMAIN_RENDER,
                               I915_GEM_DOMAIN_RENDER);
     }
+  }
   dri_bo_unmap(gpgpu->aux_buf.bo);
   return 0;
 }
@@ -2582,6 +2601,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_batch_start = (cl_gpgpu_batch_start_cb *) intel_gpgpu_batch_start;
   cl_gpgpu_batch_end = (cl_gpgpu_batch_end_cb *) intel_gpgpu_batch_end;
   cl_gpgpu_flush = (cl_gpgpu_flush_cb *) intel_gpgpu_flush;
+  cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain_gen7;
   cl_gpgpu_bind_sampler = (cl_gpgpu_bind_sampler_cb *) intel_gpgpu_bind_sampler_gen7;
   cl_gpgpu_bind_vme_state = (cl_gpgpu_bind_vme_state_cb *) intel_gpgpu_bind_vme_state_gen7;
   cl_gpgpu_set_scratch = (cl_gpgpu_set_scratch_cb *) intel_gpgpu_set_scratch;
@@ -2627,6 +2647,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen7;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain_gen8;
     return;
   }
   if (IS_GEN9(device_id)) {
@@ -2650,6 +2671,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen9;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_chain = (cl_gpgpu_chain_cb *) intel_gpgpu_chain_gen8;
     return;
   }
 
@@ -151,7 +151,10 @@ typedef struct gen8_interface_descriptor
     uint32_t barrier_return_grf_offset:8;
   } desc6;
 
-  uint32_t desc7; /* unused */
+  struct {
+    uint32_t cross_thread_curbe_read_len:8; /* in GRFs */
+    uint32_t pad:24;
+  } desc7;
 } gen8_interface_descriptor_t;
 
 typedef struct gen7_surface_state
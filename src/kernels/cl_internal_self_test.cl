@@ -0,0 +1,8 @@
+/* using __local to catch the "no SLM on Haswell" problem */
+kernel void self_test(global int *buf)
+{
+  local int tmp[3];
+  tmp[get_local_id(0)] = buf[get_local_id(0)];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];
+}
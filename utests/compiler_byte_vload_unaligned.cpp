@@ -0,0 +1,61 @@
+#include "utest_helper.hpp"
+
+static void compiler_byte_vload_unaligned(void)
+{
+  const size_t n = 16;
+  const size_t byte_n = n * 16 + 4;
+  const size_t short_n = n * 8 + 4;
+
+  // Setup kernel and buffers
+  OCL_CREATE_KERNEL("compiler_byte_vload_unaligned");
+  OCL_CREATE_BUFFER(buf[0], 0, byte_n * sizeof(uint8_t), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, byte_n * sizeof(uint8_t), NULL);
+  OCL_CREATE_BUFFER(buf[2], 0, short_n * sizeof(uint16_t), NULL);
+  OCL_CREATE_BUFFER(buf[3], 0, short_n * sizeof(uint16_t), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(cl_mem), &buf[2]);
+  OCL_SET_ARG(3, sizeof(cl_mem), &buf[3]);
+  globals[0] = n;
+  locals[0] = 16;
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  OCL_MAP_BUFFER(2);
+  OCL_MAP_BUFFER(3);
+  for (uint32_t i = 0; i < byte_n; ++i) {
+    ((uint8_t*)buf_data[0])[i] = (uint8_t)(i * 3);
+    ((uint8_t*)buf_data[1])[i] = 0xcd;
+  }
+  for (uint32_t i = 0; i < short_n; ++i) {
+    ((uint16_t*)buf_data[2])[i] = (uint16_t)(i * 1001);
+    ((uint16_t*)buf_data[3])[i] = 0xcdcd;
+  }
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(1);
+  OCL_UNMAP_BUFFER(2);
+  OCL_UNMAP_BUFFER(3);
+
+  // Run the kernel on GPU
+  OCL_NDRANGE(1);
+
+  // Compare, the bytes around the stored vectors must be left untouched
+  OCL_MAP_BUFFER(1);
+  OCL_MAP_BUFFER(3);
+  for (uint32_t i = 0; i < byte_n; ++i) {
+    uint8_t ref = 0xcd;
+    if (i >= 3 && i < 3 + n * 16)
+      ref = (uint8_t)((i - 2) * 3 + 1);
+    OCL_ASSERT(((uint8_t*)buf_data[1])[i] == ref);
+  }
+  for (uint32_t i = 0; i < short_n; ++i) {
+    uint16_t ref = 0xcdcd;
+    if (i >= 3 && i < 3 + n * 8)
+      ref = (uint16_t)((i - 2) * 1001 + 1);
+    OCL_ASSERT(((uint16_t*)buf_data[3])[i] == ref);
+  }
+  OCL_UNMAP_BUFFER(1);
+  OCL_UNMAP_BUFFER(3);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_byte_vload_unaligned);
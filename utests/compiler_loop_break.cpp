@@ -0,0 +1,56 @@
+#include "utest_helper.hpp"
+
+static void cpu(int global_id, int *src, int *dst) {
+  int sum = 0;
+  int i;
+  for (i = 0; i < 32; i++) {
+    int v = src[global_id + i];
+    if (v < 0)
+      break;
+    sum += v;
+  }
+  dst[global_id] = sum * 100 + i;
+}
+
+static void compiler_loop_break(void)
+{
+  const size_t n = 16;
+  const size_t src_n = n + 32;
+  int cpu_dst[16], cpu_src[48];
+
+  // Setup kernel and buffers
+  OCL_CREATE_KERNEL("compiler_loop_break");
+  OCL_CREATE_BUFFER(buf[0], 0, src_n * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(int), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  globals[0] = n;
+  locals[0] = 16;
+
+  // Every lane leaves the loop at a different iteration, some never break
+  for (uint32_t pass = 0; pass < 3; ++pass) {
+    OCL_MAP_BUFFER(0);
+    for (uint32_t i = 0; i < src_n; ++i) {
+      cpu_src[i] = (i % (5 + pass) == 4) ? -1 : (int)i;
+      if (pass == 2 && i < 40)
+        cpu_src[i] = (int)i;
+      ((int*)buf_data[0])[i] = cpu_src[i];
+    }
+    OCL_UNMAP_BUFFER(0);
+
+    // Run the kernel on GPU
+    OCL_NDRANGE(1);
+
+    // Run on CPU
+    for (uint32_t i = 0; i < n; ++i)
+      cpu(i, cpu_src, cpu_dst);
+
+    // Compare
+    OCL_MAP_BUFFER(1);
+    for (uint32_t i = 0; i < n; ++i)
+      OCL_ASSERT(((int*)buf_data[1])[i] == cpu_dst[i]);
+    OCL_UNMAP_BUFFER(1);
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_loop_break);
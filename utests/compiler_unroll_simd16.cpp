@@ -0,0 +1,39 @@
+#include "utest_helper.hpp"
+
+/* The forced loop unrolling must not cost the kernel its SIMD16 allocation:
+ * either it fits, or the program is built again without it */
+void compiler_unroll_simd16(void)
+{
+  const size_t n = 256;
+  size_t simd_sz = 0;
+
+  OCL_CREATE_KERNEL("compiler_unroll_simd16");
+  OCL_CREATE_BUFFER(buf[0], 0, n * 24 * sizeof(float), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(float), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+
+  OCL_CALL(clGetKernelWorkGroupInfo, kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+           sizeof(simd_sz), &simd_sz, NULL);
+  OCL_ASSERT(simd_sz == 16);
+
+  OCL_MAP_BUFFER(0);
+  for (size_t i = 0; i < n * 24; ++i)
+    ((float*)buf_data[0])[i] = (float)(i % 7);
+  OCL_UNMAP_BUFFER(0);
+
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(1);
+  for (size_t id = 0; id < n; ++id) {
+    float sum = 0.f;
+    for (int i = 0; i < 24; i++)
+      sum += (float)((id * 24 + i) % 7) * (float)((id * 24 + 23 - i) % 7) * (24 - i);
+    OCL_ASSERT(((float*)buf_data[1])[id] == sum);
+  }
+  OCL_UNMAP_BUFFER(1);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_unroll_simd16);
@@ -867,6 +867,17 @@ void get_image_info(void)
   size_t depth;
   OCL_CALL(clGetImageInfo, image, CL_IMAGE_DEPTH, sizeof(depth), &depth, NULL);
   OCL_ASSERT(depth == 0);
+
+  cl_uint tiling;
+  OCL_CALL(clGetImageInfo, image, CL_IMAGE_TILING_INTEL, sizeof(tiling), &tiling, NULL);
+  OCL_ASSERT(tiling <= CL_IMAGE_TILING_Y_INTEL);
+
+  /* Images the host keeps mapping stay linear unless OCL_TILING forces a mode */
+  if (getenv("OCL_TILING") == NULL) {
+    OCL_CREATE_IMAGE(buf[1], CL_MEM_ALLOC_HOST_PTR, &format, &desc, NULL);
+    OCL_CALL(clGetImageInfo, buf[1], CL_IMAGE_TILING_INTEL, sizeof(tiling), &tiling, NULL);
+    OCL_ASSERT(tiling == CL_IMAGE_TILING_NONE_INTEL);
+  }
 }
 
 MAKE_UTEST_FROM_FUNCTION(get_image_info);
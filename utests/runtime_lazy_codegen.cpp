@@ -0,0 +1,110 @@
+#include "utest_helper.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define DATA_N 64
+static char source_str[] =
+  "kernel void lazy_fill(__global int *dst, int value) { \n"
+  "  dst[get_global_id(0)] = value; \n"
+  "}\n"
+  "kernel void lazy_add(__global int *dst, int value) { \n"
+  "  dst[get_global_id(0)] += value + get_global_id(0); \n"
+  "}\n";
+
+static void run_kernel(cl_kernel k, cl_mem buf, int value)
+{
+  size_t globals = DATA_N, locals = 16;
+  OCL_CALL(clSetKernelArg, k, 0, sizeof(cl_mem), &buf);
+  OCL_CALL(clSetKernelArg, k, 1, sizeof(cl_int), &value);
+  OCL_CALL(clEnqueueNDRangeKernel, queue, k, 1, NULL, &globals, &locals, 0, NULL, NULL);
+}
+
+/* With OCL_LAZY_CODEGEN=1 the kernel code is generated when the kernel is
+ * created, the program binary then holds all of them */
+static void lazy_codegen(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  cl_program prog;
+  cl_kernel fill, kernels[2];
+  cl_uint kernel_n = 0;
+  size_t names_sz = 0, binary_sz = 0;
+  char names[64];
+  cl_mem buf;
+
+  prog = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  OCL_CALL(clBuildProgram, prog, 1, &device, NULL, NULL, NULL);
+  buf = clCreateBuffer(ctx, CL_MEM_READ_WRITE, DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  /* The names are known before any code is generated */
+  OCL_CALL(clGetProgramInfo, prog, CL_PROGRAM_KERNEL_NAMES, sizeof(names), names, &names_sz);
+  OCL_ASSERT(strstr(names, "lazy_fill") != NULL && strstr(names, "lazy_add") != NULL);
+  fill = clCreateKernel(prog, "lazy_unknown", &ret);
+  OCL_ASSERT(fill == NULL && ret == CL_INVALID_KERNEL_NAME);
+
+  fill = clCreateKernel(prog, "lazy_fill", &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  run_kernel(fill, buf, 3);
+
+  OCL_CALL(clCreateKernelsInProgram, prog, 2, kernels, &kernel_n);
+  OCL_ASSERT(kernel_n == 2);
+  for (int i = 0; i < 2; i++) {
+    char name[32];
+    OCL_CALL(clGetKernelInfo, kernels[i], CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    if (strcmp(name, "lazy_add") == 0)
+      run_kernel(kernels[i], buf, 5);
+  }
+
+  int *data = (int *)clEnqueueMapBuffer(queue, buf, CL_TRUE, CL_MAP_READ, 0, DATA_N * sizeof(int),
+                                        0, NULL, NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < DATA_N; i++)
+    OCL_ASSERT(data[i] == 3 + 5 + i);
+  OCL_CALL(clEnqueueUnmapMemObject, queue, buf, data, 0, NULL, NULL);
+
+  /* The binary generates the code of every kernel */
+  OCL_CALL(clGetProgramInfo, prog, CL_PROGRAM_BINARY_SIZES, sizeof(binary_sz), &binary_sz, NULL);
+  OCL_ASSERT(binary_sz > 0);
+
+  clReleaseKernel(kernels[0]);
+  clReleaseKernel(kernels[1]);
+  clReleaseKernel(fill);
+  clReleaseMemObject(buf);
+  clReleaseProgram(prog);
+}
+
+/* The backend reads OCL_LAZY_CODEGEN when it is loaded, run the case again in
+ * a child process when it is not set */
+void runtime_lazy_codegen(void)
+{
+  const char *env = getenv("OCL_LAZY_CODEGEN");
+  char exe[PATH_MAX], cmd[PATH_MAX + 64], line[256];
+  bool passed = false;
+  ssize_t len;
+  FILE *child;
+
+  if (env != NULL && atoi(env) == 1) {
+    lazy_codegen();
+    return;
+  }
+
+  len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  OCL_ASSERT(len > 0);
+  exe[len] = '\0';
+  snprintf(cmd, sizeof(cmd), "OCL_LAZY_CODEGEN=1 '%s' -c runtime_lazy_codegen 2>&1", exe);
+  child = popen(cmd, "r");
+  OCL_ASSERT(child != NULL);
+  while (fgets(line, sizeof(line), child) != NULL)
+    if (strstr(line, "pass: 1") != NULL)
+      passed = true;
+  OCL_ASSERT(pclose(child) == 0);
+  OCL_ASSERT(passed);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_lazy_codegen);
@@ -0,0 +1,65 @@
+#include "utest_helper.hpp"
+
+#define DATA_N 256
+#define KERNEL_N 40
+static char source_str[] =
+  "kernel void batch_step(__global uint *dst, uint step) { \n"
+  "  int i = get_global_id(0); \n"
+  "  dst[i] = dst[i] * 3 + step + i; \n"
+  "}\n";
+
+/* The kernels wait on a user event, so they are all ready in the same pass of
+ * the queue worker and get chained into batches. KERNEL_N is over the default
+ * OCL_BATCH_NDRANGE, the first batch is flushed because it is full and the last
+ * one by clFinish */
+void runtime_ndrange_batch(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  size_t globals = DATA_N, locals = 16;
+  cl_program prog;
+  cl_kernel k;
+  cl_mem buf;
+  cl_event user_event;
+  cl_uint expect[DATA_N];
+
+  prog = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  OCL_CALL(clBuildProgram, prog, 1, &device, NULL, NULL, NULL);
+  k = clCreateKernel(prog, "batch_step", &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  for (int i = 0; i < DATA_N; i++)
+    expect[i] = i;
+  buf = clCreateBuffer(ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(expect), expect, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  user_event = clCreateUserEvent(ctx, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  /* Each step depends on the previous one, a wrong order changes the result */
+  OCL_CALL(clSetKernelArg, k, 0, sizeof(cl_mem), &buf);
+  for (cl_uint step = 0; step < KERNEL_N; step++) {
+    OCL_CALL(clSetKernelArg, k, 1, sizeof(cl_uint), &step);
+    OCL_CALL(clEnqueueNDRangeKernel, queue, k, 1, NULL, &globals, &locals, 1, &user_event, NULL);
+    for (int i = 0; i < DATA_N; i++)
+      expect[i] = expect[i] * 3 + step + i;
+  }
+
+  OCL_CALL(clSetUserEventStatus, user_event, CL_COMPLETE);
+  OCL_CALL(clFinish, queue);
+
+  cl_uint *data = (cl_uint *)clEnqueueMapBuffer(queue, buf, CL_TRUE, CL_MAP_READ, 0, sizeof(expect),
+                                                0, NULL, NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < DATA_N; i++)
+    OCL_ASSERT(data[i] == expect[i]);
+  OCL_CALL(clEnqueueUnmapMemObject, queue, buf, data, 0, NULL, NULL);
+
+  clReleaseEvent(user_event);
+  clReleaseMemObject(buf);
+  clReleaseKernel(k);
+  clReleaseProgram(prog);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_ndrange_batch);
@@ -0,0 +1,112 @@
+#include "utest_helper.hpp"
+#include <dirent.h>
+
+#define DATA_N 64
+static char source_str[] =
+  "kernel void add_value(__global int *dst, int value) { \n"
+  "  dst[get_global_id(0)] += value; \n"
+  "}\n";
+
+typedef cl_int (OCLREPORTKERNELUPLOADSINTEL)(void);
+static OCLREPORTKERNELUPLOADSINTEL *oclReportKernelUploadsIntel = NULL;
+
+static int count_fds(void)
+{
+  DIR *dir = opendir("/proc/self/fd");
+  int n = 0;
+
+  OCL_ASSERT(dir != NULL);
+  while (readdir(dir) != NULL)
+    n++;
+  closedir(dir);
+  return n;
+}
+
+/* Build and run the same kernel in a context, the code uploaded by the
+ * first context is shared with the next ones. upload_n is the number of
+ * uploads it takes, no file descriptor stays open for the sharing */
+static void run_in_context(cl_context context, int value, int upload_n)
+{
+  const char *source = source_str;
+  size_t source_size = sizeof(source_str);
+  size_t globals = DATA_N, locals = 16;
+  cl_int ret;
+
+  cl_command_queue q = clCreateCommandQueue(context, device, 0, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  int fd_n = count_fds();
+  cl_int uploads = oclReportKernelUploadsIntel();
+  cl_program program = clCreateProgramWithSource(context, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  cl_kernel kernels[2];
+  for (int i = 0; i < 2; i++) {
+    kernels[i] = clCreateKernel(program, "add_value", &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+  OCL_ASSERT(oclReportKernelUploadsIntel() == uploads + upload_n);
+  OCL_ASSERT(count_fds() == fd_n);
+  cl_mem mem = clCreateBuffer(context, CL_MEM_READ_WRITE, DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  int zero = 0;
+  ret = clEnqueueFillBuffer(q, mem, &zero, sizeof(zero), 0, DATA_N * sizeof(int), 0, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  for (int i = 0; i < 2; i++) {
+    OCL_ASSERT(clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &mem) == CL_SUCCESS);
+    OCL_ASSERT(clSetKernelArg(kernels[i], 1, sizeof(int), &value) == CL_SUCCESS);
+    ret = clEnqueueNDRangeKernel(q, kernels[i], 1, NULL, &globals, &locals, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+
+  int *map_ptr = (int *)clEnqueueMapBuffer(q, mem, CL_TRUE, CL_MAP_READ, 0, DATA_N * sizeof(int),
+                                           0, NULL, NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < DATA_N; i++)
+    OCL_ASSERT(map_ptr[i] == 2 * value);
+  clEnqueueUnmapMemObject(q, mem, map_ptr, 0, NULL, NULL);
+  clFinish(q);
+
+  clReleaseMemObject(mem);
+  for (int i = 0; i < 2; i++)
+    clReleaseKernel(kernels[i]);
+  clReleaseProgram(program);
+  clReleaseCommandQueue(q);
+}
+
+void runtime_shared_isa(void)
+{
+  const char *source = source_str;
+  size_t source_size = sizeof(source_str);
+  cl_int ret;
+
+#ifdef CL_VERSION_1_2
+  oclReportKernelUploadsIntel = (OCLREPORTKERNELUPLOADSINTEL *)clGetExtensionFunctionAddressForPlatform(platform, "clReportKernelUploadsIntel");
+#else
+  oclReportKernelUploadsIntel = (OCLREPORTKERNELUPLOADSINTEL *)clGetExtensionFunctionAddress("clReportKernelUploadsIntel");
+#endif
+  OCL_ASSERT(oclReportKernelUploadsIntel != NULL);
+
+  /* Keep a kernel alive in the default context while the other context
+   * sets up the same code */
+  cl_program program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  OCL_ASSERT(clBuildProgram(program, 1, &device, NULL, NULL, NULL) == CL_SUCCESS);
+  cl_kernel kernel = clCreateKernel(program, "add_value", &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  cl_context other = clCreateContext(NULL, 1, &device, NULL, NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  run_in_context(ctx, 3, 0);
+  run_in_context(other, 5, 0);
+
+  /* Once every kernel is released the code is uploaded again */
+  clReleaseKernel(kernel);
+  clReleaseProgram(program);
+  run_in_context(other, 7, 1);
+
+  clReleaseContext(other);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_shared_isa);
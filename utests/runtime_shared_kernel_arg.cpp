@@ -0,0 +1,180 @@
+#include "utest_helper.hpp"
+
+#define THREAD_SIZE 8
+#define LOOP_N 16
+#define DATA_N 64
+static pthread_t tid[THREAD_SIZE];
+static int thread_num[THREAD_SIZE];
+static cl_command_queue all_queues[THREAD_SIZE];
+static cl_mem all_bufs[THREAD_SIZE];
+static cl_kernel the_kernel;
+static char source_str[] =
+  "kernel void fill_value(__global int *dst, int value) { \n"
+  "  dst[get_global_id(0)] = value; \n"
+  "}\n";
+
+/* All the threads set the arguments of the same kernel and launch it, with
+ * no lock: each launch must only see the arguments of its own thread */
+static void *thread_function(void *arg)
+{
+  int num = *((int *)arg);
+  size_t globals = DATA_N, locals = 16;
+  cl_int ret;
+
+  for (int loop = 0; loop < LOOP_N; loop++) {
+    int value = num * LOOP_N + loop;
+    ret = clSetKernelArg(the_kernel, 0, sizeof(cl_mem), &all_bufs[num]);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    ret = clSetKernelArg(the_kernel, 1, sizeof(cl_int), &value);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    ret = clEnqueueNDRangeKernel(all_queues[num], the_kernel, 1, NULL, &globals, &locals,
+                                 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+
+    int *map_ptr = (int *)clEnqueueMapBuffer(all_queues[num], all_bufs[num], CL_TRUE, CL_MAP_READ,
+                                             0, DATA_N * sizeof(int), 0, NULL, NULL, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(map_ptr[i] == value);
+    ret = clEnqueueUnmapMemObject(all_queues[num], all_bufs[num], map_ptr, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+  clFinish(all_queues[num]);
+  return NULL;
+}
+
+void runtime_shared_kernel_arg(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  cl_program program = NULL;
+  int i;
+
+  program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  the_kernel = clCreateKernel(program, "fill_value", NULL);
+  OCL_ASSERT(the_kernel != NULL);
+
+  for (i = 0; i < THREAD_SIZE; i++) {
+    all_queues[i] = clCreateCommandQueue(ctx, device, 0, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    all_bufs[i] = clCreateBuffer(ctx, CL_MEM_READ_WRITE, DATA_N * sizeof(int), NULL, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+
+  for (i = 0; i < THREAD_SIZE; i++) {
+    thread_num[i] = i;
+    pthread_create(&tid[i], NULL, thread_function, &thread_num[i]);
+  }
+  for (i = 0; i < THREAD_SIZE; i++)
+    pthread_join(tid[i], NULL);
+
+  clReleaseKernel(the_kernel);
+  clReleaseProgram(program);
+  for (i = 0; i < THREAD_SIZE; i++) {
+    clReleaseMemObject(all_bufs[i]);
+    clReleaseCommandQueue(all_queues[i]);
+  }
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_shared_kernel_arg);
+
+static void *set_value_function(void *arg)
+{
+  OCL_ASSERT(clSetKernelArg(the_kernel, 1, sizeof(cl_int), arg) == CL_SUCCESS);
+  return NULL;
+}
+
+/* The arguments a thread staged only go with its next launch: a later one
+ * sees the values another thread set meanwhile */
+void runtime_shared_kernel_arg_expire(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  size_t globals = DATA_N, locals = 16;
+  cl_program program = NULL;
+  cl_mem buf;
+  pthread_t setter;
+  int value = 1, other_value = 2;
+
+  program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  the_kernel = clCreateKernel(program, "fill_value", NULL);
+  OCL_ASSERT(the_kernel != NULL);
+  buf = clCreateBuffer(ctx, CL_MEM_READ_WRITE, DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  OCL_ASSERT(clSetKernelArg(the_kernel, 0, sizeof(cl_mem), &buf) == CL_SUCCESS);
+  OCL_ASSERT(clSetKernelArg(the_kernel, 1, sizeof(cl_int), &value) == CL_SUCCESS);
+  for (int loop = 0; loop < 2; loop++) {
+    ret = clEnqueueNDRangeKernel(queue, the_kernel, 1, NULL, &globals, &locals, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    int *map_ptr = (int *)clEnqueueMapBuffer(queue, buf, CL_TRUE, CL_MAP_READ,
+                                             0, DATA_N * sizeof(int), 0, NULL, NULL, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(map_ptr[i] == (loop == 0 ? value : other_value));
+    ret = clEnqueueUnmapMemObject(queue, buf, map_ptr, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+
+    pthread_create(&setter, NULL, set_value_function, &other_value);
+    pthread_join(setter, NULL);
+  }
+
+  clReleaseMemObject(buf);
+  clReleaseKernel(the_kernel);
+  clReleaseProgram(program);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_shared_kernel_arg_expire);
+
+static void *set_buffer_function(void *arg)
+{
+  OCL_ASSERT(clSetKernelArg(the_kernel, 0, sizeof(cl_mem), arg) == CL_SUCCESS);
+  return NULL;
+}
+
+/* Short lived threads stage an argument and exit without a launch. Their
+ * stages are reused by the next threads, so the buffer is only kept by the
+ * kernel object and a single stage whatever the number of threads */
+void runtime_shared_kernel_arg_threads(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  cl_program program = NULL;
+  cl_uint ref_n = 0;
+  cl_mem buf;
+  pthread_t setter;
+
+  program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  the_kernel = clCreateKernel(program, "fill_value", NULL);
+  OCL_ASSERT(the_kernel != NULL);
+  buf = clCreateBuffer(ctx, CL_MEM_READ_WRITE, DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  for (int i = 0; i < 64; i++) {
+    pthread_create(&setter, NULL, set_buffer_function, &buf);
+    pthread_join(setter, NULL);
+  }
+
+  OCL_CALL(clGetMemObjectInfo, buf, CL_MEM_REFERENCE_COUNT, sizeof(ref_n), &ref_n, NULL);
+  OCL_ASSERT(ref_n <= 3);
+
+  clReleaseKernel(the_kernel);
+  OCL_CALL(clGetMemObjectInfo, buf, CL_MEM_REFERENCE_COUNT, sizeof(ref_n), &ref_n, NULL);
+  OCL_ASSERT(ref_n == 1);
+  clReleaseMemObject(buf);
+  clReleaseProgram(program);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_shared_kernel_arg_threads);
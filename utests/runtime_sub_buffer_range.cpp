@@ -0,0 +1,170 @@
+#include "utest_helper.hpp"
+#include <string.h>
+
+#define DATA_N 4096
+#define LOOP_N 8
+static char source_str[] =
+  "kernel void fill_value(__global int *dst, int value) { \n"
+  "  dst[get_global_id(0)] = value; \n"
+  "}\n";
+
+/* A kernel fills one sub-buffer while the host writes and reads back the
+ * other one of the same parent, in an out-of-order queue */
+void runtime_sub_buffer_range(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  size_t globals = DATA_N, locals = 16;
+  cl_buffer_region region;
+  cl_program program;
+  cl_kernel kernel;
+  cl_command_queue ooo_queue;
+  cl_mem parent, sub[2];
+  int host[DATA_N];
+
+  cl_uint align = 0;
+  clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align), &align, NULL);
+  OCL_ASSERT(DATA_N * sizeof(int) % (align / 8) == 0);
+
+  program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  kernel = clCreateKernel(program, "fill_value", &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ooo_queue = clCreateCommandQueue(ctx, device, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  parent = clCreateBuffer(ctx, CL_MEM_READ_WRITE, 2 * DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < 2; i++) {
+    region.origin = i * DATA_N * sizeof(int);
+    region.size = DATA_N * sizeof(int);
+    sub[i] = clCreateSubBuffer(parent, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+
+  for (int loop = 0; loop < LOOP_N; loop++) {
+    int value = loop + 1;
+    OCL_ASSERT(clSetKernelArg(kernel, 0, sizeof(cl_mem), &sub[0]) == CL_SUCCESS);
+    OCL_ASSERT(clSetKernelArg(kernel, 1, sizeof(cl_int), &value) == CL_SUCCESS);
+    ret = clEnqueueNDRangeKernel(ooo_queue, kernel, 1, NULL, &globals, &locals, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+
+    for (int i = 0; i < DATA_N; i++)
+      host[i] = -value * i;
+    ret = clEnqueueWriteBuffer(ooo_queue, sub[1], CL_TRUE, 0, sizeof(host), host, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    memset(host, 0, sizeof(host));
+    ret = clEnqueueReadBuffer(ooo_queue, sub[1], CL_TRUE, 0, sizeof(host), host, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(host[i] == -value * i);
+
+    clFinish(ooo_queue);
+    ret = clEnqueueReadBuffer(ooo_queue, sub[0], CL_TRUE, 0, sizeof(host), host, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(host[i] == value);
+  }
+
+  clReleaseMemObject(sub[0]);
+  clReleaseMemObject(sub[1]);
+  clReleaseMemObject(parent);
+  clReleaseCommandQueue(ooo_queue);
+  clReleaseKernel(kernel);
+  clReleaseProgram(program);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_sub_buffer_range);
+
+/* A kernel writes the sub-buffer at a nonzero origin, then the host maps or
+ * reads it right away, blocking and non-blocking */
+void runtime_sub_buffer_range_origin(void)
+{
+  cl_int ret;
+  size_t source_size = sizeof(source_str);
+  const char *source = source_str;
+  size_t globals = DATA_N, locals = 16;
+  cl_buffer_region region;
+  cl_program program;
+  cl_kernel kernel;
+  cl_mem parent, sub[2];
+  cl_event ev;
+  int host[DATA_N];
+  int *mapped;
+
+  cl_uint align = 0;
+  clGetDeviceInfo(device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align), &align, NULL);
+  OCL_ASSERT(DATA_N * sizeof(int) % (align / 8) == 0);
+
+  program = clCreateProgramWithSource(ctx, 1, &source, &source_size, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  kernel = clCreateKernel(program, "fill_value", &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  parent = clCreateBuffer(ctx, CL_MEM_READ_WRITE, 2 * DATA_N * sizeof(int), NULL, &ret);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < 2; i++) {
+    region.origin = i * DATA_N * sizeof(int);
+    region.size = DATA_N * sizeof(int);
+    sub[i] = clCreateSubBuffer(parent, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+  }
+  for (int i = 0; i < DATA_N; i++)
+    host[i] = -i;
+  ret = clEnqueueWriteBuffer(queue, sub[0], CL_TRUE, 0, sizeof(host), host, 0, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+
+  for (int loop = 0; loop < LOOP_N; loop++) {
+    int value = loop + 1;
+    cl_bool blocking = (loop & 1) ? CL_FALSE : CL_TRUE;
+    OCL_ASSERT(clSetKernelArg(kernel, 0, sizeof(cl_mem), &sub[1]) == CL_SUCCESS);
+    OCL_ASSERT(clSetKernelArg(kernel, 1, sizeof(cl_int), &value) == CL_SUCCESS);
+
+    /* Map the sub-buffer right after the kernel writing it */
+    ret = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globals, &locals, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    mapped = (int *)clEnqueueMapBuffer(queue, sub[1], blocking, CL_MAP_READ, 0,
+                                       sizeof(host), 0, NULL, &ev, &ret);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    if (!blocking)
+      OCL_ASSERT(clWaitForEvents(1, &ev) == CL_SUCCESS);
+    clReleaseEvent(ev);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(mapped[i] == value);
+    ret = clEnqueueUnmapMemObject(queue, sub[1], mapped, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+
+    /* Read it right after the kernel writing it */
+    value = -value;
+    OCL_ASSERT(clSetKernelArg(kernel, 1, sizeof(cl_int), &value) == CL_SUCCESS);
+    ret = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globals, &locals, 0, NULL, NULL);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    memset(host, 0, sizeof(host));
+    ret = clEnqueueReadBuffer(queue, sub[1], blocking, 0, sizeof(host), host, 0, NULL, &ev);
+    OCL_ASSERT(ret == CL_SUCCESS);
+    if (!blocking)
+      OCL_ASSERT(clWaitForEvents(1, &ev) == CL_SUCCESS);
+    clReleaseEvent(ev);
+    for (int i = 0; i < DATA_N; i++)
+      OCL_ASSERT(host[i] == value);
+  }
+
+  /* The kernel must not have touched the first sub-buffer */
+  ret = clEnqueueReadBuffer(queue, sub[0], CL_TRUE, 0, sizeof(host), host, 0, NULL, NULL);
+  OCL_ASSERT(ret == CL_SUCCESS);
+  for (int i = 0; i < DATA_N; i++)
+    OCL_ASSERT(host[i] == -i);
+
+  clReleaseMemObject(sub[0]);
+  clReleaseMemObject(sub[1]);
+  clReleaseMemObject(parent);
+  clReleaseKernel(kernel);
+  clReleaseProgram(program);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_sub_buffer_range_origin);